@@ -0,0 +1,321 @@
+#include <cmath>
+#include <cstdint>
+#include "acquisition.h"
+
+// two blocks used in turn: one is filled while the other is processed
+static float blocks[2][FFT_SIZE];
+static int ready = -1; // finished block waiting for loop()
+static int held = -1;  // block loop() is working on
+static unsigned long overruns = 0;
+
+// sliding level window, kept in integer sums of undivided ADC sums so
+// adding and removing samples never drifts
+static uint16_t levelRing[ACQ_RMS_WINDOW];
+static size_t levelPos = 0;
+static size_t levelFill = 0;
+static size_t levelSinceHop = 0;
+static uint32_t levelSum = 0;
+static uint64_t levelSumSq = 0;
+static uint32_t levelUpdates = 0;
+static uint32_t levelSamples = 0;
+static VibrationLevel level = {0.0f, 0.0f, 0, 0};
+
+// add one sample (the sum of ACQ_DECIMATION ADC readings), true when a
+// new level is due and has been written to out
+static bool levelAdd(uint16_t acc, VibrationLevel &out)
+{
+    if (levelFill == ACQ_RMS_WINDOW)
+    {
+        uint16_t old = levelRing[levelPos];
+        levelSum -= old;
+        levelSumSq -= (uint32_t)old * old;
+    }
+    else
+    {
+        levelFill++;
+    }
+    levelRing[levelPos] = acc;
+    levelSum += acc;
+    levelSumSq += (uint32_t)acc * acc;
+    levelPos = (levelPos + 1) % ACQ_RMS_WINDOW;
+    levelSamples++;
+
+    if (levelFill < ACQ_RMS_WINDOW || ++levelSinceHop < ACQ_RMS_HOP)
+    {
+        return false;
+    }
+    levelSinceHop = 0;
+    // n * sum(x^2) - sum(x)^2 is exact and never negative
+    uint64_t spread = (uint64_t)ACQ_RMS_WINDOW * levelSumSq - (uint64_t)levelSum * levelSum;
+    const float scale = 1.0f / ((float)ACQ_RMS_WINDOW * ACQ_DECIMATION);
+    out.rms = sqrtf((float)spread) * scale;
+    out.mean = (float)levelSum * scale;
+    out.updates = ++levelUpdates;
+    out.sample = levelSamples;
+    return true;
+}
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+#include <driver/i2s.h>
+#include <driver/adc.h>
+
+#define ACQ_I2S_PORT I2S_NUM_0
+#define ACQ_ADC_CHANNEL ADC1_CHANNEL_4 // GPIO32, PIEZO_PIN
+#define ACQ_DMA_LEN 256                // samples per DMA buffer
+
+static portMUX_TYPE acqLock = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t readerHandle;
+static volatile bool restartRequested = false;
+static volatile size_t restartPretrigger = 0;
+
+// recent samples for the pre-trigger, as undivided ADC sums
+static uint16_t history[ACQ_PRETRIGGER];
+static size_t historyPos = 0;
+static size_t historyFill = 0;
+
+// called by the reader task when blocks[filling] is complete, returns the
+// block to fill next
+static int publishBlock(int filling)
+{
+    int next = filling;
+    portENTER_CRITICAL(&acqLock);
+    int other = 1 - filling;
+    if (ready < 0 && held != other)
+    {
+        ready = filling;
+        next = other;
+    }
+    else
+    {
+        // loop() still has the other block, reuse this one and lose its data
+        overruns++;
+    }
+    portEXIT_CRITICAL(&acqLock);
+    return next;
+}
+
+static void readerTask(void *args)
+{
+    static uint16_t raw[ACQ_DMA_LEN];
+    VibrationLevel latest;
+    int filling = 0;
+    size_t pos = 0;
+    uint32_t acc = 0;
+    int n = 0;
+    while (true)
+    {
+        size_t bytes = 0;
+        i2s_read(ACQ_I2S_PORT, raw, sizeof(raw), &bytes, portMAX_DELAY);
+        if (restartRequested)
+        {
+            restartRequested = false;
+            // start the block with the most recent samples, oldest first
+            size_t back = restartPretrigger < historyFill ? restartPretrigger : historyFill;
+            for (pos = 0; pos < back; pos++)
+            {
+                blocks[filling][pos] = (float)history[(historyPos + ACQ_PRETRIGGER - back + pos) % ACQ_PRETRIGGER] / ACQ_DECIMATION;
+            }
+            if (pos == FFT_SIZE)
+            {
+                filling = publishBlock(filling);
+                pos = 0;
+            }
+            acc = 0;
+            n = 0;
+        }
+        for (size_t i = 0; i < bytes / sizeof(uint16_t); i++)
+        {
+            // the top four bits carry the channel number
+            acc += raw[i] & 0x0FFF;
+            if (++n < ACQ_DECIMATION)
+            {
+                continue;
+            }
+            blocks[filling][pos++] = (float)acc / ACQ_DECIMATION;
+            history[historyPos] = acc;
+            historyPos = (historyPos + 1) % ACQ_PRETRIGGER;
+            if (historyFill < ACQ_PRETRIGGER)
+            {
+                historyFill++;
+            }
+            if (levelAdd(acc, latest))
+            {
+                portENTER_CRITICAL(&acqLock);
+                level = latest;
+                portEXIT_CRITICAL(&acqLock);
+            }
+            acc = 0;
+            n = 0;
+            if (pos == FFT_SIZE)
+            {
+                filling = publishBlock(filling);
+                pos = 0;
+            }
+        }
+    }
+}
+
+bool acquisitionBegin()
+{
+    i2s_config_t cfg = {};
+    cfg.mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_RX | I2S_MODE_ADC_BUILT_IN);
+    cfg.sample_rate = ACQ_ADC_RATE;
+    cfg.bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT;
+    cfg.channel_format = I2S_CHANNEL_FMT_ONLY_LEFT;
+    cfg.communication_format = I2S_COMM_FORMAT_STAND_I2S;
+    cfg.intr_alloc_flags = 0;
+    cfg.dma_buf_count = 4;
+    cfg.dma_buf_len = ACQ_DMA_LEN;
+    cfg.use_apll = false;
+
+    if (i2s_driver_install(ACQ_I2S_PORT, &cfg, 0, NULL) != ESP_OK)
+    {
+        Serial.println("I2S driver install failed");
+        return false;
+    }
+    i2s_set_adc_mode(ADC_UNIT_1, ACQ_ADC_CHANNEL);
+    adc1_config_channel_atten(ACQ_ADC_CHANNEL, ADC_ATTEN_DB_11); // same 0-3.3 V range as analogRead
+    i2s_adc_enable(ACQ_I2S_PORT);
+
+    // above loop() so DMA buffers are drained on time, on core 1 next to the processing
+    xTaskCreatePinnedToCore(readerTask, "ACQ", 4096, NULL, configMAX_PRIORITIES - 2, &readerHandle, 1);
+    return true;
+}
+
+const float *acquisitionBlock()
+{
+    const float *block = nullptr;
+    portENTER_CRITICAL(&acqLock);
+    if (held < 0 && ready >= 0)
+    {
+        held = ready;
+        ready = -1;
+    }
+    if (held >= 0)
+    {
+        block = blocks[held];
+    }
+    portEXIT_CRITICAL(&acqLock);
+    return block;
+}
+
+void acquisitionRelease()
+{
+    portENTER_CRITICAL(&acqLock);
+    held = -1;
+    portEXIT_CRITICAL(&acqLock);
+}
+
+void acquisitionRestart(size_t pretrigger)
+{
+    portENTER_CRITICAL(&acqLock);
+    ready = -1;
+    held = -1;
+    restartPretrigger = pretrigger < ACQ_PRETRIGGER ? pretrigger : ACQ_PRETRIGGER;
+    restartRequested = true;
+    overruns = 0;
+    portEXIT_CRITICAL(&acqLock);
+}
+
+void acquisitionLevel(VibrationLevel &out)
+{
+    portENTER_CRITICAL(&acqLock);
+    out = level;
+    portEXIT_CRITICAL(&acqLock);
+}
+
+unsigned long acquisitionOverruns()
+{
+    return overruns;
+}
+
+#else
+
+#include <cstdio>
+#include <cstdlib>
+
+static FILE *source = nullptr;
+
+bool acquisitionBegin(const char *path)
+{
+    if (source)
+    {
+        fclose(source);
+    }
+    source = fopen(path, "r");
+    ready = -1;
+    held = -1;
+    return source != nullptr;
+}
+
+// read the next FFT_SIZE numeric lines, skipping any log text between them
+static bool readBlock(float *block)
+{
+    char line[128];
+    size_t pos = 0;
+    while (pos < FFT_SIZE && fgets(line, sizeof(line), source))
+    {
+        char *end;
+        long v = strtol(line, &end, 10);
+        if (end != line && (*end == '\n' || *end == '\r' || *end == '\0'))
+        {
+            block[pos++] = (float)v;
+            levelAdd((uint16_t)(v * ACQ_DECIMATION), level);
+        }
+    }
+    return pos == FFT_SIZE;
+}
+
+const float *acquisitionBlock()
+{
+    if (held < 0)
+    {
+        if (!source || !readBlock(blocks[0]))
+        {
+            return nullptr;
+        }
+        held = 0;
+    }
+    return blocks[held];
+}
+
+void acquisitionRelease()
+{
+    held = -1;
+}
+
+void acquisitionRestart(size_t pretrigger)
+{
+    // a replayed file has no samples from before the restart to back-date with
+    (void)pretrigger;
+    held = -1;
+    overruns = 0;
+}
+
+void acquisitionPushSample(float v)
+{
+    levelAdd((uint16_t)(v * ACQ_DECIMATION), level);
+}
+
+void acquisitionPushLevel(float rms, float mean, size_t samples)
+{
+    levelSamples += samples;
+    level.rms = rms;
+    level.mean = mean;
+    level.updates = ++levelUpdates;
+    level.sample = levelSamples;
+}
+
+void acquisitionLevel(VibrationLevel &out)
+{
+    out = level;
+}
+
+unsigned long acquisitionOverruns()
+{
+    return overruns;
+}
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef ACQUISITION_H
+#define ACQUISITION_H
+
+#include "vibration.h"
+
+/*
+ * Gapless vibration acquisition.
+ *
+ * On the ESP32 the built-in ADC is clocked by I2S and its samples land in
+ * memory by DMA, so the sample rate is fixed by hardware and no CPU time is
+ * spent per sample. A reader task averages every ACQ_DECIMATION ADC samples
+ * into one vibration sample (which also low-pass filters them) and fills two
+ * FFT_SIZE blocks in turn. A finished block is handed to loop() while the
+ * other one fills, so processing a block never stops sampling as long as it
+ * is released within one block time.
+ *
+ * The reader task also keeps running sums over the last ACQ_RMS_WINDOW
+ * samples, so the vibration level is always available without sampling
+ * anything on demand, and the last ACQ_PRETRIGGER samples so a cycle can be
+ * started from before the moment it was detected. The replay build has no
+ * history and ignores the pre-trigger.
+ *
+ * Off the device the same API replays samples from a text file with one
+ * ADC reading per line, such as the serial captures, so the processing
+ * chain can be run on a PC.
+ */
+
+#define ACQ_DECIMATION 8 // ADC samples averaged into one vibration sample
+#define ACQ_ADC_RATE ((unsigned long)VIBRATION_SAMPLE_RATE * ACQ_DECIMATION)
+#define ACQ_RMS_WINDOW 500 // samples in the sliding level window, 500 ms
+#define ACQ_RMS_HOP 100    // samples between level updates, 100 ms
+#define ACQ_PRETRIGGER FFT_SIZE // samples kept for back-dating a cycle start, 2 s
+
+// vibration level over the last ACQ_RMS_WINDOW samples
+struct VibrationLevel
+{
+    float rms;        // about the window mean, ADC counts
+    float mean;       // ADC counts
+    uint32_t updates; // increases by one every ACQ_RMS_HOP samples, 0 until the first full window
+    uint32_t sample;  // samples acquired up to the end of the window
+};
+
+#ifdef ARDUINO
+// start the I2S ADC and the reader task, false if the driver failed
+bool acquisitionBegin();
+#else
+// replay samples from a file, false if it cannot be opened
+bool acquisitionBegin(const char *path);
+
+// replay a capture line by line instead: one ADC reading into the level
+// window, or a level that was logged already computed
+void acquisitionPushSample(float v);
+void acquisitionPushLevel(float rms, float mean, size_t samples);
+#endif
+
+// the oldest finished block of FFT_SIZE samples, or nullptr if none is ready.
+// never blocks. The same block is returned until it is released
+const float *acquisitionBlock();
+
+// give the block back so it can be filled again
+void acquisitionRelease();
+
+// drop any finished block and start a fresh one, e.g. when a cycle starts.
+// The new block begins with up to ACQ_PRETRIGGER samples from before the
+// call, so a start detected late still has its beginning
+void acquisitionRestart(size_t pretrigger = 0);
+
+// latest level, copied out in a few microseconds
+void acquisitionLevel(VibrationLevel &level);
+
+// blocks dropped since the last acquisitionRestart() because the previous
+// one was not released in time. Blocks nobody asks for between cycles are
+// dropped too, so this only means something while blocks are being read
+unsigned long acquisitionOverruns();
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef BITSTREAM_H
+#define BITSTREAM_H
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Bit fields packed into bytes least significant bit first, shared by the
+ * record codecs. Fields are up to 32 bits wide. The writer clears each byte
+ * as it reaches it, so the output buffer need not be zeroed.
+ */
+struct BitWriter
+{
+    uint8_t *out;
+    size_t cap; // bytes
+    size_t bitPos;
+
+    bool put(uint32_t v, int width)
+    {
+        if (bitPos + width > cap * 8)
+        {
+            return false;
+        }
+        for (int done = 0; done < width;)
+        {
+            size_t byte = bitPos >> 3;
+            int offset = bitPos & 7;
+            int take = 8 - offset < width - done ? 8 - offset : width - done;
+            if (offset == 0)
+            {
+                out[byte] = 0;
+            }
+            out[byte] |= (uint8_t)(((v >> done) & ((1u << take) - 1)) << offset);
+            bitPos += take;
+            done += take;
+        }
+        return true;
+    }
+
+    size_t bytes() const
+    {
+        return (bitPos + 7) / 8;
+    }
+};
+
+struct BitReader
+{
+    const uint8_t *in;
+    size_t len; // bytes
+    size_t bitPos;
+
+    bool get(int width, uint32_t &v)
+    {
+        if (bitPos + width > len * 8)
+        {
+            return false;
+        }
+        v = 0;
+        for (int done = 0; done < width;)
+        {
+            int offset = bitPos & 7;
+            int take = 8 - offset < width - done ? 8 - offset : width - done;
+            v |= (uint32_t)((in[bitPos >> 3] >> offset) & ((1u << take) - 1)) << done;
+            bitPos += take;
+            done += take;
+        }
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,159 @@
+#include <cmath>
+#include "changePoint.h"
+
+// Siegmund's correction to the CUSUM threshold
+static const float SIEGMUND_OFFSET = 1.166f;
+
+// approximate in-control average run length of a CUSUM, k and h in sigmas
+static float runLength(float k, float h)
+{
+    float b = h + SIEGMUND_OFFSET;
+    if (k < 1e-4f)
+    {
+        return b * b;
+    }
+    float a = 2.0f * k * b;
+    return (expf(a) - a - 1.0f) / (2.0f * k * k);
+}
+
+float ChangeDetector::thresholdFor(float k, float arl)
+{
+    // the run length grows monotonically with h, so bisect for it
+    float lo = 0.0f;
+    float hi = 50.0f;
+    for (int i = 0; i < 40; i++)
+    {
+        float mid = 0.5f * (lo + hi);
+        if (runLength(k, mid) < arl)
+        {
+            lo = mid;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return hi;
+}
+
+ChangeDetector::ChangeDetector(float shift, float arl, size_t warmup, float minSigma)
+    : k(0.5f * shift), warmup(warmup), minSigma(minSigma)
+{
+    h = thresholdFor(k, arl);
+    reset();
+}
+
+void ChangeDetector::reset()
+{
+    reference.reset();
+    refMean = 0.0f;
+    refSigma = minSigma;
+    restart(0);
+}
+
+void ChangeDetector::restart(uint32_t time)
+{
+    up = 0.0f;
+    down = 0.0f;
+    upStart = time;
+    downStart = time;
+    sinceReset.reset();
+    phUp = 0.0f;
+    phUpMin = 0.0f;
+    phDown = 0.0f;
+    phDownMax = 0.0f;
+    phUpMinTime = time;
+    phDownMaxTime = time;
+}
+
+bool ChangeDetector::learning() const
+{
+    return reference.count < warmup;
+}
+
+float ChangeDetector::mean() const
+{
+    return refMean;
+}
+
+float ChangeDetector::sigma() const
+{
+    return refSigma;
+}
+
+float ChangeDetector::threshold() const
+{
+    return h;
+}
+
+bool ChangeDetector::update(float x, uint32_t time, Change &change)
+{
+    if (learning())
+    {
+        reference.add(&x);
+        if (!learning())
+        {
+            refMean = reference.mean[0];
+            refSigma = sqrtf(reference.variance(0));
+            if (refSigma < minSigma)
+            {
+                refSigma = minSigma;
+            }
+            restart(time + 1);
+        }
+        return false;
+    }
+
+    float z = (x - refMean) / refSigma;
+
+    // CUSUM, each side remembers when it last left zero
+    if (up <= 0.0f)
+    {
+        upStart = time;
+    }
+    if (down <= 0.0f)
+    {
+        downStart = time;
+    }
+    up = fmaxf(0.0f, up + z - k);
+    down = fmaxf(0.0f, down - z - k);
+
+    // Page-Hinkley against the running mean of everything since the reference was set
+    sinceReset.add(&z);
+    float dev = z - sinceReset.mean[0];
+    phUp += dev - k;
+    phDown += dev + k;
+    if (phUp < phUpMin)
+    {
+        phUpMin = phUp;
+        phUpMinTime = time;
+    }
+    if (phDown > phDownMax)
+    {
+        phDownMax = phDown;
+        phDownMaxTime = time;
+    }
+
+    change.alarmTime = time;
+    if (up > h || down > h)
+    {
+        change.direction = up > down ? 1 : -1;
+        change.changeTime = up > down ? upStart : downStart;
+        change.test = TEST_CUSUM;
+    }
+    else if (phUp - phUpMin > h || phDownMax - phDown > h)
+    {
+        change.direction = phUp - phUpMin > phDownMax - phDown ? 1 : -1;
+        // the extreme is the last sample of the old level
+        change.changeTime = (change.direction > 0 ? phUpMinTime : phDownMaxTime) + 1;
+        change.test = TEST_PAGE_HINKLEY;
+    }
+    else
+    {
+        return false;
+    }
+
+    // learn the new level before looking for the next change
+    reference.reset();
+    return true;
+}
@@ -0,0 +1,86 @@
+#ifndef CHANGEPOINT_H
+#define CHANGEPOINT_H
+
+#include <cstddef>
+#include <cstdint>
+#include "runningStats.h"
+
+/*
+ * Sequential change-point detection on one stream, in constant memory.
+ *
+ * After a reset the first warmup samples fix the in-control mean and
+ * standard deviation. From then on two tests run side by side on the
+ * standardised samples:
+ *
+ *  - a two-sided CUSUM against the warm-up mean, tuned for a shift of
+ *    `shift` standard deviations,
+ *  - a two-sided Page-Hinkley test against the running mean since the
+ *    reset, with the same drift allowance and threshold.
+ *
+ * The threshold is chosen so the CUSUM raises a false alarm on average once
+ * every `arl` in-control samples (Siegmund's approximation), which makes the
+ * trade between latency and false triggers one explicit number.
+ *
+ * On an alarm the detector reports the direction, the sample at which the
+ * change most likely began (where the winning statistic last left zero, or
+ * its extreme for Page-Hinkley) and which test fired. It then learns the new
+ * level as its reference, so a start is followed by looking for a stop.
+ * Sample times are whatever counter the caller passes in.
+ */
+class ChangeDetector
+{
+public:
+    enum Test
+    {
+        TEST_CUSUM,
+        TEST_PAGE_HINKLEY
+    };
+
+    struct Change
+    {
+        int direction;       // +1 the level rose, -1 it fell
+        uint32_t changeTime; // estimated first sample of the new level
+        uint32_t alarmTime;  // sample the alarm was raised at
+        Test test;
+    };
+
+    // shift and minSigma in the stream's units of standard deviations and
+    // values, arl in samples
+    ChangeDetector(float shift, float arl, size_t warmup, float minSigma);
+
+    // false while learning the reference or when nothing changed
+    bool update(float x, uint32_t time, Change &change);
+
+    // forget the reference and learn it again from the next samples
+    void reset();
+
+    bool learning() const;
+    float mean() const;  // reference mean, valid once learning() is false
+    float sigma() const;
+    float threshold() const; // h, in standard deviations
+
+    // h for which a CUSUM with allowance k has an in-control run length of arl
+    static float thresholdFor(float k, float arl);
+
+private:
+    void restart(uint32_t time);
+
+    float k;    // allowance, half the shift, in standard deviations
+    float h;
+    size_t warmup;
+    float minSigma;
+
+    RunningStats<1> reference;
+    float refMean;
+    float refSigma;
+
+    float up, down; // CUSUM statistics
+    uint32_t upStart, downStart;
+
+    RunningStats<1> sinceReset; // Page-Hinkley running mean
+    float phUp, phUpMin;
+    float phDown, phDownMax;
+    uint32_t phUpMinTime, phDownMaxTime;
+};
+
+#endif
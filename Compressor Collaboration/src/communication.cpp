@@ -34,7 +34,8 @@ String lastVibStr = "";
 
 
 // --------------------- STATUS CHECK -------------------------
-void statusCheck(float zTemp, float zVibr, String& lStatus) {
+// detail explains the vibration score and is appended to any alert
+void statusCheck(float zTemp, float zVibr, String& lStatus, const String& detail) {
 
     bool doubleWarn = 
         (zTemp >= TEMP_WARNING_THRESHOLD && zTemp < TEMP_CRIT_THRESHOLD) &&
@@ -48,7 +49,7 @@ void statusCheck(float zTemp, float zVibr, String& lStatus) {
         critCounter++;
 
         if (lStatus != newStatus) {
-            sendCriticalAlert();
+            sendCriticalAlert(detail);
             preferences.putLong("msgAlertId", msgAlertId);
         }
     }
@@ -58,7 +59,7 @@ void statusCheck(float zTemp, float zVibr, String& lStatus) {
         warnCounter++;
 
         if (lStatus != newStatus) {
-            sendWarningAlert();
+            sendWarningAlert(detail);
             preferences.putLong("msgAlertId", msgAlertId);
         }
     }
@@ -202,19 +203,19 @@ void preferencesStartup(bool isNew){
 */
 
 // --------------------- ALERTS -------------------------
-void sendWarningAlert() {
+void sendWarningAlert(const String& detail) {
     deleteMessage(msgAlertId);
     msgAlertId = sendTelegramMessage(
         "⚠️ WARNING: COMPRESSOR 1 IS SHOWING SIGNS OF FAILURE ⚠️ Count: " +
-        String(warnCounter)
+        String(warnCounter) + " | " + detail
     );
 }
 
-void sendCriticalAlert() {
+void sendCriticalAlert(const String& detail) {
     deleteMessage(msgAlertId);
     msgAlertId = sendTelegramMessage(
         "❌ CRITICAL: COMPRESSOR 1 IS IN CRITICAL CONDITION ❌ Count: " +
-        String(critCounter)
+        String(critCounter) + " | " + detail
     );
 }
 
@@ -37,14 +37,14 @@ extern String lastTempStr;
 extern String lastVibStr;
 
 // Function prototypes
-void statusCheck(float zTemp, float zVibr, String& lStatus);
+void statusCheck(float zTemp, float zVibr, String& lStatus, const String& detail);
 void updateDataMessages(String TStr, String& lTStr, String VStr, String& lVStr);
 void preferencesStartup(bool isNew);
 
 void checkTelegram();
 
-void sendWarningAlert();
-void sendCriticalAlert();
+void sendWarningAlert(const String& detail);
+void sendCriticalAlert(const String& detail);
 
 long sendTelegramMessage(String message);
 void updateMessage(long messageId, String newText);
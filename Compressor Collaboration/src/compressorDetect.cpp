@@ -1,79 +1,38 @@
 // compressor_detect.cpp
 #include "compressorDetect.h"
 #include "dataStorage.h"
+#include "storage.h"
 #include "getTemp.h"
-
-#define PIEZO_PIN 32
+#include "acquisition.h"
 
 // Parameters you can tune
-static const int WINDOW_MS = 500;           // window length used to compute RMS (ms)
-static const int SAMPLE_INTERVAL_US = 1000; // sample spacing (us) -> 1 kHz sampling
-static const float EMA_ALPHA = 0.01f;       // baseline EMA smoothing factor (0..1). small=slow adapt
+static const float EMA_ALPHA = 0.002f;      // baseline EMA smoothing per level update (every 100 ms). small=slow adapt
 static const float THRESH_ON_MULT = 2.0f;   // turn ON if RMS > baseline * THRESH_ON_MULT
 static const float THRESH_OFF_MULT = 1.5f;  // turn OFF if RMS < baseline * THRESH_OFF_MULT
-static const int REQ_ON_COUNTS = 3;         // consecutive windows needed to declare ON
-static const int REQ_OFF_COUNTS = 3;        // consecutive windows needed to declare OFF
+static const int REQ_ON_COUNTS = 3;         // consecutive level updates needed to declare ON
+static const int REQ_OFF_COUNTS = 3;        // consecutive level updates needed to declare OFF
 static const char *BASELINE_PATH = "/baseline.bin";
 
 static float baselineRms = -1.0f; // if <0 -> not initialized
 static int onCounter = 0;
 static int offCounter = 0;
+static uint32_t lastUpdate = 0;   // level update already acted on
 static unsigned long lastPersist = 0;
 static const unsigned long PERSIST_INTERVAL_MS = 60 * 1000UL; // persist baseline every minute
 
-// helper: compute RMS over short window
-static float sampleWindowRms()
-{
-    const int samples = WINDOW_MS * 1000 / SAMPLE_INTERVAL_US;
-    long sumSq = 0;
-    long sum = 0;
-    for (int i = 0; i < samples; i++)
-    {
-        unsigned long start = micros();
-        int v = analogRead(PIEZO_PIN);
-        sum += v;
-        sumSq += (long)v * (long)v;
-
-        // Wait for remainder of interval
-        unsigned long elapsed = micros() - start;
-        if (elapsed < SAMPLE_INTERVAL_US)
-        {
-            delayMicroseconds(SAMPLE_INTERVAL_US - elapsed);
-        }
-    }
-    float mean = sum / (float)samples;
-    // compute variance via E[x^2] - mean^2 but implement safely:
-    float ex2 = sumSq / (float)samples;
-    float var = ex2 - mean * mean;
-    if (var < 0)
-        var = 0; // numerical safety
-    float rms = sqrt(var);
-    return rms;
-}
-
-// persistence
+// persistence, journaled so a reset mid-write keeps the previous value. The
+// save is queued to the storage task so the detector never waits on the card
 static void loadBaselineFromSd()
 {
-    if (!SD.exists(BASELINE_PATH))
-        return;
-    File f = SD.open(BASELINE_PATH, FILE_READ);
-    if (!f)
-        return;
-    if (f.size() >= sizeof(float))
+    if (!loadBinary(BASELINE_PATH, &baselineRms, sizeof(baselineRms)))
     {
-        f.read((uint8_t *)&baselineRms, sizeof(float));
+        baselineRms = -1.0f;
     }
-    f.close();
 }
 
 static void persistBaselineToSd()
 {
-    SD.remove(BASELINE_PATH); // Delete first
-    File f = SD.open(BASELINE_PATH, FILE_WRITE);
-    if (!f)
-        return;
-    f.write((uint8_t *)&baselineRms, sizeof(float));
-    f.close();
+    storeBinary(BASELINE_PATH, &baselineRms, sizeof(baselineRms));
 }
 
 // The exported function
@@ -93,7 +52,15 @@ bool compressorRunning(bool currentState)
         }
     }
 
-    float rms = sampleWindowRms();
+    // the acquisition task keeps the window up to date, only act on a new one
+    VibrationLevel level;
+    acquisitionLevel(level);
+    if (level.updates == 0 || level.updates == lastUpdate)
+    {
+        return currentState;
+    }
+    lastUpdate = level.updates;
+    float rms = level.rms;
 
     // If baseline unknown, initialize it to the first measured RMS (conservative)
     if (baselineRms < 0)
@@ -119,13 +86,12 @@ bool compressorRunning(bool currentState)
     float onThreshold = baselineRms * THRESH_ON_MULT;
     float offThreshold = baselineRms * THRESH_OFF_MULT;
 
-    logPrintln("RMS: " + String(rms, 2) + " baseline: " + String(baselineRms, 2) +
-               " thr_on: " + String(onThreshold, 2) + " thr_off: " + String(offThreshold, 2));
-
     if (millis() - lastPersist > PERSIST_INTERVAL_MS)
     {
         persistBaselineToSd();
         lastPersist = millis();
+        logPrintln("RMS: " + String(rms, 2) + " baseline: " + String(baselineRms, 2) +
+                   " thr_on: " + String(onThreshold, 2) + " thr_off: " + String(offThreshold, 2));
         logPrintln("Baseline persisted: " + String(baselineRms));
     }
 
@@ -172,254 +138,243 @@ bool compressorRunning(bool currentState)
     }
 }
 
-std::vector<float> tempvect;
-std::vector<float> savedReadings;
-static int readings = 30;        //TODO change back to 30
-static const int window = 5000; // window length used to compute RMS (ms)
-//static int onCounter = 0;
-//static int offCounter = 0;
-static int timeCounter = 0;
-// static const int SAMPLE_INTERVAL_US = 10000; // sample spacing (us) -> 1 kHz sampling
+TempTransitionDetector::TempTransitionDetector() : delta(0.0f)
+{
+    reset();
+}
+
+void TempTransitionDetector::reset()
+{
+    head = 0;
+    count = 0;
+    lastSample = millis() - SAMPLE_MS;
+    sinceEval = 0;
+    onCounter = 0;
+    offCounter = 0;
+}
+
+float TempTransitionDetector::lastDelta() const
+{
+    return delta;
+}
+
+float TempTransitionDetector::at(size_t i) const
+{
+    return ring[(head + CAPACITY - count + i) % CAPACITY];
+}
 
-std::vector<float> simpleTempDetect()
+Transition TempTransitionDetector::update()
 {
-    if (tempvect.size() < readings)
+    float temp;
+    TempStatus status = getTemp(temp); // also keeps the conversions going
+    if (millis() - lastSample < SAMPLE_MS || status != TEMP_OK)
     {
-        tempvect.push_back(getTemp());
+        return TRANSITION_NONE;
     }
-    else
+    lastSample = millis();
+
+    if (count == 0)
     {
-        tempvect.push_back(getTemp());
-        tempvect.erase(tempvect.begin());
-        tempvect.shrink_to_fit();
-        float delta = (tempvect.back() - tempvect[readings * 0.666]);
-        logPrint("Temp Delta: " + String(delta) + ", " + String(tempvect[readings * 0.666]) + ", " + String(tempvect.back()));
-        logPrint("\n");
-        delay(window);
-        timeCounter++;
-        if (timeCounter == 6) // TODO change back to 6
+        // start from a flat history so the first check comes EVAL_SAMPLES readings later
+        for (size_t i = 0; i < CAPACITY; i++)
         {
-            timeCounter = 0;
-            if (delta > 0)
-            {
-                onCounter++;
-                offCounter = 0;
-                for (float i : tempvect)
-                {
-                    savedReadings.push_back(i);
-                }
-                Serial.println("onCounter incremented to: " + String(onCounter));
-            }
-            else if (delta < 0) 
-            {
-                offCounter++;
-                onCounter = 0;
-                savedReadings.clear();
-                savedReadings.shrink_to_fit();
-                Serial.println("offCounter incremented to: " + String(offCounter));
-            }
-            else
-            {
-                onCounter = 0;
-                offCounter = 0;
-                savedReadings.clear();
-                savedReadings.shrink_to_fit();
-                Serial.println("Delta in middle range, resetting counters");
-            }
-            Serial.println("Checking: onCounter=" + String(onCounter) + ", offCounter=" + String(offCounter));
-            if (onCounter == 4)
-            {
-                onCounter = 0;
-                Serial.println("onDetected");
-                tempvect.clear();
-                tempvect.shrink_to_fit();
-                return tempvect;
-            }
-            if (offCounter == 4)
-            {
-                offCounter = 0;
-                Serial.println("offDetected");
-                tempvect.clear();
-                tempvect.shrink_to_fit();
-                return {-1};
-            }
+            ring[i] = temp;
         }
+        head = 0;
+        count = CAPACITY;
+        return TRANSITION_NONE;
     }
-    return {0};
-}
+    ring[head] = temp;
+    head = (head + 1) % CAPACITY;
 
-/*
-
-// bool compressorRunning(bool stateNow)
-// {
-//     const int SAMPLES = 1000;  // 1 second at 1ms intervals
-//     const float THRESHOLD_MULTIPLIER = 1.0;  // 3x baseline variance
-//     static float baselineVariance = 5000;//80; // 900; //809.11;// 857.69; //-1;  // Computed once when off //434.42 whencompressor running
-//     static float lowVarianceBasleine = 40;
-//     static int consecutiveDetections = 0;
-//     const int REQUIRED_DETECTIONS = 4;
-
-//     // Collect samples
-//     int readings[SAMPLES];
-//     long sum = 0;
-
-//     for (int i = 0; i < SAMPLES; i++)
-//     {
-//         readings[i] = analogRead(PIEZO_PIN);
-//         sum += readings[i];
-//         delay(1);  // 1ms between samples
-//     }
-
-//     // Calculate mean
-//     float mean = sum / (float)SAMPLES;
-
-//     // Calculate variance (measure of vibration intensity)
-//     float variance = 0;
-//     for (int i = 0; i < SAMPLES; i++)
-//     {
-//         float diff = readings[i] - mean;
-//         variance += diff * diff;
-//     }
-//     variance = variance / SAMPLES;
+    if (++sinceEval < EVAL_SAMPLES)
+    {
+        return TRANSITION_NONE;
+    }
+    sinceEval = 0;
 
-//     // First time: establish baseline (when compressor is off)
-//     //TODO change this to be accurate to the first time that the compressor turns on.
-//     if (baselineVariance < 0)
-//     {
-//         baselineVariance = variance;
-//         logPrintln("Baseline variance set: " + String(baselineVariance));
-//         return false;
-//     }
-//     // Check if current variance exceeds threshold
-//     if (stateNow == false) //compressor off looking for on
-//     {
-//         logPrintln("Current variance: " + String(variance) + " (baseline: " + String(baselineVariance) + ")");
-//         if (variance > baselineVariance * THRESHOLD_MULTIPLIER)
-//         {
-//             consecutiveDetections++;
-//             if (consecutiveDetections >= REQUIRED_DETECTIONS)
-//             {
-//                 return false; //TODO change so it happens
-//             }
-//         }
-//         else
-//         {
-//             consecutiveDetections = 0;  // Reset if we miss one
-//         }
-//         return false;
-//     }
-//     else    //compressor on looking for off
-//     {
-//         logPrintln("Current variance: " + String(variance) + " (baseline: " + String(lowVarianceBasleine) + ")");
-//         if (variance < lowVarianceBasleine)
-//         {
-//             consecutiveDetections++;
-//             if (consecutiveDetections >= REQUIRED_DETECTIONS)
-//             {
-//                 return false;
-//             }
-//         }
-//         else
-//         {
-//             consecutiveDetections = 0;  // Reset if we miss one
-//         }
-//         return true;
-//     }
+    float older = at(CAPACITY * 2 / 3);
+    delta = at(CAPACITY - 1) - older;
+    logPrintln("Temp Delta: " + String(delta) + ", " + String(older) + ", " + String(at(CAPACITY - 1)));
+    if (delta > 0)
+    {
+        onCounter++;
+        offCounter = 0;
+    }
+    else if (delta < 0)
+    {
+        offCounter++;
+        onCounter = 0;
+    }
+    else
+    {
+        onCounter = 0;
+        offCounter = 0;
+    }
+    if (onCounter >= REQUIRED_COUNTS)
+    {
+        reset();
+        return TRANSITION_ON;
+    }
+    if (offCounter >= REQUIRED_COUNTS)
+    {
+        reset();
+        return TRANSITION_OFF;
+    }
+    return TRANSITION_NONE;
+}
 
-// }
-bool compressorRunning(bool stateNow)
+// change-point tuning. Shifts are in standard deviations of the in-control
+// stream, run lengths in samples of it. The run length is that of one side
+// of the CUSUM; both sides and the Page-Hinkley test together alarm more
+// often, so the false alarm interval is under half of it
+static const float VIB_SHIFT = 3.0f;
+static const float VIB_ARL = 1.0e7f;       // level updates, 11.6 days per side at 10 a second
+static const size_t VIB_WARMUP = 50;       // 5 s of level updates
+static const float VIB_MIN_SIGMA = 0.02f;  // log RMS, about 2 %
+static const float VIB_MIN_RMS = 1.0f;     // counts, a disconnected sensor reads below this
+static const float VIB_RUN_RATIO = 2.0f;   // running is at least this many times the off RMS
+static const int VIB_LEVEL_COUNTS = 3;     // levels in a row that must agree with that
+static const uint32_t VIB_SETTLE_SAMPLES = (uint32_t)(10 * VIBRATION_SAMPLE_RATE); // start-up transient, 10 s
+static const char *OFF_LEVEL_PATH = "/vibration/offLevel.bin";
+static const float TEMP_SHIFT = 2.0f;
+static const float TEMP_ARL = 1.0e5f;      // readings, 5.8 days per side at one every 5 s
+static const size_t TEMP_WARMUP = 24;      // 2 min of readings
+static const float TEMP_MIN_SIGMA = 0.05f; // degrees F per reading
+
+CompressorDetector::CompressorDetector()
+    : on(false), vibAgrees(false), tempAgrees(false), lastUpdate(0), changeSample(0), settleUntil(0),
+      offLevelLoaded(false), haveOffLevel(false), offLevel(0.0f), levelCount(0),
+      vibration(VIB_SHIFT, VIB_ARL, VIB_WARMUP, VIB_MIN_SIGMA),
+      temperature(TEMP_SHIFT, TEMP_ARL, TEMP_WARMUP, TEMP_MIN_SIGMA),
+      lastTempSample(0), lastTemp(-1000)
 {
-    const int SAMPLES = 400;       // Faster detection, ~400ms
-    const int REQUIRED_DETECTIONS = 3;
-
-    static bool calibratedOff = false;
-    static bool calibratedOn = false;
-
-    static float offBaseline = 0;  // true OFF variance (~50–200)
-    static float onBaseline = 0;   // true ON variance (~3000–14000)
-
-    static int confirmCount = 0;
+}
 
-    // ---------------------------------------
-    // Collect samples
-    // ---------------------------------------
-    long sum = 0;
-    int readings[SAMPLES];
+bool CompressorDetector::running() const
+{
+    return on;
+}
 
-    for (int i = 0; i < SAMPLES; i++)
+float CompressorDetector::confidence() const
+{
+    if (vibAgrees && tempAgrees)
     {
-        readings[i] = analogRead(PIEZO_PIN);
-        sum += readings[i];
-        delayMicroseconds(800); // ~1ms sampling
+        return 1.0f;
     }
-
-    float mean = sum / float(SAMPLES);
-
-    float variance = 0;
-    for (int i = 0; i < SAMPLES; i++)
+    if (vibAgrees)
     {
-        float d = readings[i] - mean;
-        variance += d * d;
+        return 0.6f;
     }
-    variance /= SAMPLES;
-
-    logPrintln("Variance: " + String(variance) + " baseline: " + String(offBaseline));
+    return tempAgrees ? 0.4f : 0.0f;
+}
 
-    // ---------------------------------------
-    // OFF baseline calibration (first startup)
-    // ---------------------------------------
-    if (!calibratedOff && !stateNow)
+size_t CompressorDetector::samplesSinceChange() const
+{
+    if (changeSample == 0)
     {
-        offBaseline = (offBaseline == 0) ? variance : (offBaseline * 0.8 + variance * 0.2);
-
-        if (offBaseline > 0 && variance < offBaseline * 1.5)
-            calibratedOff = true;
-
-        logPrintln("Calibrating OFF baseline: " + String(offBaseline));
-        return false;
+        return 0;
     }
+    VibrationLevel level;
+    acquisitionLevel(level);
+    return level.sample - changeSample;
+}
 
-    // ---------------------------------------
-    // ON baseline calibration (first detection)
-    // ---------------------------------------
-    if (!calibratedOn && stateNow)
+Transition CompressorDetector::update()
+{
+    ChangeDetector::Change change;
+    if (!offLevelLoaded)
     {
-        onBaseline = (onBaseline == 0) ? variance : (onBaseline * 0.8 + variance * 0.2);
-
-        if (onBaseline > offBaseline * 3)
-            calibratedOn = true;
-
-        logPrintln("Calibrating ON baseline: " + String(onBaseline));
-        return true;
+        offLevelLoaded = true;
+        haveOffLevel = loadBinary(OFF_LEVEL_PATH, &offLevel, sizeof(offLevel));
     }
 
-    // ---------------------------------------
-    // Thresholding Logic
-    // ---------------------------------------
-    float onThreshold = offBaseline * 4;  // OFF <200, ON >800 typically
-    float offThreshold = onBaseline * 0.2; // ON >2000, OFF <400 typically
-
-    if (!stateNow) // searching for ON
+    // vibration, one step per new level once the start-up transient has passed
+    VibrationLevel level;
+    acquisitionLevel(level);
+    bool vibAvailable = level.updates > 0 && level.rms >= VIB_MIN_RMS && (haveOffLevel || !vibration.learning());
+    int vibStep = 0;
+    if (level.updates != lastUpdate && level.rms >= VIB_MIN_RMS && (int32_t)(level.sample - settleUntil) >= 0)
     {
-        if (variance > onThreshold)
+        lastUpdate = level.updates;
+        float x = logf(level.rms);
+        bool running = haveOffLevel && x > offLevel + logf(VIB_RUN_RATIO);
+        bool learning = vibration.learning();
+        if (vibration.update(x, level.sample, change))
         {
-            if (++confirmCount >= REQUIRED_DETECTIONS)
-                return true;
+            // a step that stays on one side of the off level only moved the level
+            vibStep = haveOffLevel && (change.direction > 0) != running ? 0 : change.direction;
+            // the window reaches back one hop before the level that first moved
+            changeSample = change.changeTime > ACQ_RMS_HOP ? change.changeTime - ACQ_RMS_HOP : 1;
+            logPrintln("Vibration change " + String(vibStep > 0 ? "up" : "down") + " by " +
+                       (change.test == ChangeDetector::TEST_CUSUM ? "CUSUM" : "Page-Hinkley") + ", began " +
+                       String((change.alarmTime - changeSample) / VIBRATION_SAMPLE_RATE, 1) + " s before");
+        }
+        else if (learning && haveOffLevel)
+        {
+            // no reference to test against yet, compare with the off level
+            levelCount = running != on ? levelCount + 1 : 0;
+            if (levelCount >= VIB_LEVEL_COUNTS)
+            {
+                vibStep = running ? 1 : -1;
+                changeSample = 0;
+                vibration.reset();
+                logPrintln(String("Vibration level ") + (running ? "above" : "back at") + " the off level");
+            }
+        }
+        if (learning && !vibration.learning() && !on && vibStep == 0)
+        {
+            offLevel = vibration.mean();
+            haveOffLevel = true;
+            storeBinary(OFF_LEVEL_PATH, &offLevel, sizeof(offLevel));
         }
-        else confirmCount = 0;
-
-        return false;
     }
-    else // searching for OFF
+
+    // temperature, one step per reading, a rising trend means running
+    int tempStep = 0;
+    float temp;
+    TempStatus status = getTemp(temp); // also keeps the conversions going
+    if (millis() - lastTempSample >= TEMP_SAMPLE_MS && status == TEMP_OK)
     {
-        if (variance < offThreshold)
+        lastTempSample = millis();
+        if (lastTemp > -1000 && temperature.update(temp - lastTemp, lastTempSample, change))
         {
-            if (++confirmCount >= REQUIRED_DETECTIONS)
-                return false;
+            tempStep = change.direction;
+            logPrintln("Temperature trend change " + String(tempStep > 0 ? "up" : "down") + ", began " +
+                       String((change.alarmTime - change.changeTime) / 1000.0f, 0) + " s before");
         }
-        else confirmCount = 0;
+        lastTemp = temp;
+    }
 
-        return true;
+    int flipStep = on ? -1 : 1;
+    if (tempStep == -flipStep && !tempAgrees)
+    {
+        // trend agrees with the state we are in
+        tempAgrees = true;
+        logPrintln("Temperature trend confirms compressor " + String(on ? "on" : "off"));
+    }
+
+    // vibration decides, the temperature trend alone only when vibration cannot
+    bool vibFlip = vibStep == flipStep;
+    bool tempFlip = tempStep == flipStep && !vibAvailable;
+    if (!vibFlip && !tempFlip)
+    {
+        return TRANSITION_NONE;
+    }
+
+    on = !on;
+    vibAgrees = vibFlip;
+    tempAgrees = tempStep == flipStep;
+    levelCount = 0;
+    if (!vibFlip)
+    {
+        changeSample = 0;
+    }
+    if (on && vibFlip && changeSample != 0)
+    {
+        settleUntil = level.sample + VIB_SETTLE_SAMPLES;
     }
+    logPrintln(String("Compressor ") + (on ? "on" : "off") + " by " + (vibFlip ? "vibration" : "temperature") +
+               ", confidence " + String(confidence(), 1));
+    return on ? TRANSITION_ON : TRANSITION_OFF;
 }
-*/
\ No newline at end of file
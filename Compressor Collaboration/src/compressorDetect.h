@@ -5,8 +5,114 @@
 #include <Arduino.h>
 #include <SD.h>
 #include <vector>
+#include "changePoint.h"
 
 bool compressorRunning(bool currentState); // call regularly from loop()
-std::vector<float> simpleTempDetect();
+
+enum Transition
+{
+    TRANSITION_NONE,
+    TRANSITION_ON,
+    TRANSITION_OFF
+};
+
+/*
+ * Compressor on/off detection from the temperature trend.
+ *
+ * Readings are taken every SAMPLE_MS into a fixed ring buffer. Every
+ * EVAL_SAMPLES readings the rise over the newest third of the buffer is
+ * checked, and REQUIRED_COUNTS rises (or falls) in a row report a
+ * transition, after which the detector starts over. update() never waits:
+ * it takes a reading only when one is due and returns straight away, so
+ * loop() stays free for other work. Nothing is allocated.
+ */
+class TempTransitionDetector
+{
+public:
+    static const size_t CAPACITY = 30;
+    static const unsigned long SAMPLE_MS = 5000;
+    static const int EVAL_SAMPLES = 6;
+    static const int REQUIRED_COUNTS = 4;
+
+    TempTransitionDetector();
+
+    // call regularly from loop()
+    Transition update();
+
+    // forget the buffered readings and counters
+    void reset();
+
+    // rise over the newest third at the last check, kept across reset()
+    float lastDelta() const;
+
+private:
+    float at(size_t i) const; // i = 0 is the oldest reading
+
+    float ring[CAPACITY];
+    size_t head;  // where the next reading goes
+    size_t count; // 0 until the first reading, then CAPACITY
+    unsigned long lastSample;
+    int sinceEval;
+    int onCounter;
+    int offCounter;
+    float delta;
+};
+
+/*
+ * Compressor on/off detection fusing vibration and temperature.
+ *
+ * Both signals go through ChangeDetector (CUSUM and Page-Hinkley): the log
+ * of the streaming vibration RMS, where a start or stop is a step within a
+ * second, and the change between 5 s temperature readings, where it shows
+ * as the trend turning over. A vibration change decides a transition, and a
+ * temperature change in the same direction confirms it, or decides on its
+ * own when no vibration level is available. confidence() says how much
+ * evidence backs the current state: both signals, vibration only or
+ * temperature only.
+ *
+ * Levels for a short while after a start are not used, so the settling of
+ * the start-up transient is neither learned as the running level nor taken
+ * for a stop. The level learned while off is kept on the card. Until a new
+ * reference is learned, levels are compared with it instead, which finds a
+ * compressor that was already running at boot and undoes a start that did
+ * not hold.
+ *
+ * The false alarm rate of each test is set by its average run length, and
+ * a start is reported with the sample it most likely began at so the cycle
+ * can be back-dated with acquisitionRestart().
+ */
+class CompressorDetector
+{
+public:
+    static const unsigned long TEMP_SAMPLE_MS = 5000;
+
+    CompressorDetector();
+
+    // call regularly from loop(), returns the transition if one was decided
+    Transition update();
+
+    bool running() const;
+    float confidence() const; // 0..1
+
+    // samples acquired since the last transition probably began, 0 if it
+    // was decided by temperature alone
+    size_t samplesSinceChange() const;
+
+private:
+    bool on;           // fused state
+    bool vibAgrees;    // vibration backs the fused state
+    bool tempAgrees;   // temperature trend backs the fused state
+    uint32_t lastUpdate;  // vibration level already fed to the detector
+    uint32_t changeSample; // acquisition sample the last vibration change began at, 0 if none
+    uint32_t settleUntil;  // levels before this acquisition sample are the start-up transient
+    bool offLevelLoaded;   // read from the card
+    bool haveOffLevel;
+    float offLevel;        // log RMS while off
+    int levelCount;        // levels in a row on the other side of the off level
+    ChangeDetector vibration;
+    ChangeDetector temperature;
+    unsigned long lastTempSample;
+    float lastTemp; // -1000 until the first good reading
+};
 
 #endif
\ No newline at end of file
@@ -2,7 +2,12 @@
 #include <vector>
 #include <SD.h>
 #include "dataStorage.h"
+#include "recordFormat.h"
+#include "spectrumCodec.h"
+#include "vibration.h"
 #include <cassert>
+#include <algorithm>
+#include <time.h>
 
 // count number of files in the folders
 int countFiles(Mode mode)
@@ -28,62 +33,537 @@ int countFiles(Mode mode)
   return count;
 }
 
-// Vibration is vector of floats - frequencies of the fourier
-void writeData(Mode mode, std::vector<float> vector, int cycle_num)
+// ---------------- binary segments ----------------
+// Each mode appends its records to /<mode>/<YYYYMMDD>/segNNN.bin, one
+// directory per UTC day so no directory grows without bound. Records are
+// collected in a RAM buffer and written back to back, so every write is one
+// bulk transfer instead of a println per value and a flush costs no padding.
+//
+// /<mode>/index.bin lists every record (cycle, type, time, segment and byte
+// offset) in the order written. It is appended to after each flush, so boot
+// only reads its last entry instead of listing directories, and a record is
+// found by a binary search over cycles instead of a scan.
+
+#define SEGMENT_BUFFER 4096                   // bytes collected before a write
+#define SEGMENT_MAX_BYTES (4UL * 1024 * 1024) // a new segment is started past this
+#define INDEX_PENDING 8                       // records buffered before their index entries are written
+
+struct IndexEntry
 {
-  File myFile;
-  // open file to write to
-  if (mode == TEMPERATURE)
+  int32_t cycle;
+  uint32_t time;    // record timestamp
+  uint32_t day;     // directory of the segment, 0 until the clock is set
+  uint16_t segment; // file within the day
+  uint8_t type;     // RecordType
+  uint8_t reserved;
+  uint32_t offset; // of the record in its segment
+  uint32_t length;
+  uint32_t crc; // CRC-32 of the fields above
+};
+
+static_assert(sizeof(IndexEntry) == 28, "index entries must stay packed");
+
+static const uint32_t INDEX_MAGIC = 0x58444943; // "CIDX"
+
+struct IndexHeader
+{
+  uint32_t magic;
+  uint32_t entrySize;
+  int32_t firstCycle; // next cycle when the index was started, for cards with csv files
+};
+
+struct Segment
+{
+  uint8_t buf[SEGMENT_BUFFER];
+  size_t used;
+  bool loaded;   // index read
+  uint32_t day;  // current segment file, index -1 until there is one
+  int index;
+  uint32_t size; // bytes already on the card
+  int32_t nextCycle;
+  uint32_t entries; // in the index file
+  IndexEntry last;  // most recent entry, valid when entries > 0
+  IndexEntry pending[INDEX_PENDING];
+  size_t pendingCount;
+};
+
+static Segment segments[2];
+static uint8_t recordScratch[RECORD_MAX_BYTES];
+static int16_t spectrumReference[SPECTRUM_BINS];
+static bool haveSpectrumReference = false;
+
+static const char *modeDir(Mode mode)
+{
+  return (mode == TEMPERATURE) ? "/temperature" : "/vibration";
+}
+
+static String dayPath(Mode mode, uint32_t day)
+{
+  char name[16];
+  snprintf(name, sizeof(name), "/%08lu", (unsigned long)day);
+  return String(modeDir(mode)) + name;
+}
+
+static String segmentPath(Mode mode, uint32_t day, int index)
+{
+  char name[16];
+  snprintf(name, sizeof(name), "/seg%03d.bin", index);
+  return dayPath(mode, day) + name;
+}
+
+static String indexPath(Mode mode)
+{
+  return String(modeDir(mode)) + "/index.bin";
+}
+
+// UTC date as YYYYMMDD, 0 while the clock is not set
+static uint32_t dayOf(uint32_t timestamp)
+{
+  if (timestamp <= 1600000000)
+  {
+    return 0;
+  }
+  time_t t = timestamp;
+  struct tm date;
+  gmtime_r(&t, &date);
+  return (date.tm_year + 1900) * 10000 + (date.tm_mon + 1) * 100 + date.tm_mday;
+}
+
+static String baseName(File &f)
+{
+  // older cores return the full path
+  String name = String(f.name());
+  return name.substring(name.lastIndexOf('/') + 1);
+}
+
+// number of a segNNN.bin file name, -1 for anything else
+static int segmentNumber(const String &name)
+{
+  if (!name.startsWith("seg") || !name.endsWith(".bin"))
   {
-    myFile = SD.open("/temperature/data" + String(cycle_num) + ".csv", FILE_WRITE);
-    if (myFile)
+    return -1;
+  }
+  return name.substring(3, name.length() - 4).toInt();
+}
+
+// offset of the next record magic at or after pos, the size if there is none
+static uint32_t nextMagic(File &myFile, uint32_t pos, uint32_t size)
+{
+  const uint32_t magic = RECORD_MAGIC;
+  while (pos + sizeof(RecordHeader) <= size)
+  {
+    myFile.seek(pos);
+    size_t got = myFile.read(recordScratch, sizeof(recordScratch));
+    if (got < sizeof(magic))
+    {
+      break;
+    }
+    for (size_t i = 0; i + sizeof(magic) <= got; i++)
     {
-      // parse through passed temp vector and write to the file
-      for (int i = 0; i < vector.size(); i++)
+      if (memcmp(recordScratch + i, &magic, sizeof(magic)) == 0)
       {
-        myFile.println(vector[i]);
+        return pos + i;
       }
     }
-    myFile.close();
+    pos += got - (sizeof(magic) - 1);
   }
-  if (mode == VIBRATION)
+  return size;
+}
+
+// walk every intact record of one segment file from byte start on, visit
+// gets its header, offset and length. Returns the file size
+template <typename Visit>
+static uint32_t scanSegment(const String &path, uint32_t start, Visit visit)
+{
+  if (!SD.exists(path))
+  {
+    return 0;
+  }
+  File myFile = SD.open(path, FILE_READ);
+  if (!myFile)
   {
-    myFile = SD.open("/vibration/data" + String(cycle_num) + ".csv", FILE_WRITE);
-    if (myFile)
+    return 0;
+  }
+  uint32_t size = myFile.size();
+  uint32_t pos = start;
+  while (pos + sizeof(RecordHeader) <= size)
+  {
+    RecordHeader h;
+    myFile.seek(pos);
+    if (myFile.read((uint8_t *)&h, sizeof(h)) != sizeof(h))
+    {
+      break;
+    }
+    size_t len = sizeof(h) + h.payloadBytes;
+    if (headerValid(h) && len <= sizeof(recordScratch))
     {
-      // parse through passed temp vector and write to file
-      for (int i = 0; i < vector.size(); i++)
+      memcpy(recordScratch, &h, sizeof(h));
+      if (myFile.read(recordScratch + sizeof(h), h.payloadBytes) == h.payloadBytes &&
+          recordIntact(recordScratch, len))
       {
-        myFile.println(vector[i]);
+        visit(h, pos, len);
+        pos += len;
+        continue;
       }
     }
-    myFile.close();
+    // damage, records are packed so the next one can start anywhere
+    pos = nextMagic(myFile, pos + 1, size);
   }
+  myFile.close();
+  return size;
 }
 
-// write baseline storing functions for both
-// take vector store in file
-void saveBaseline(Mode mode, std::vector<float> vector)
+static IndexEntry makeEntry(const RecordHeader &h, uint32_t day, int segment, uint32_t offset, size_t len)
 {
-  File myFile;
-  // save a baseline vector according to mode (VIBRATION or TEMPERATURE)
-  if (mode == TEMPERATURE)
+  IndexEntry e;
+  memset(&e, 0, sizeof(e));
+  e.cycle = h.cycle;
+  e.time = h.timestamp;
+  e.day = day;
+  e.segment = (uint16_t)segment;
+  e.type = h.type;
+  e.offset = offset;
+  e.length = (uint32_t)len;
+  e.crc = crc32(&e, offsetof(IndexEntry, crc));
+  return e;
+}
+
+static bool entryValid(const IndexEntry &e)
+{
+  return e.crc == crc32(&e, offsetof(IndexEntry, crc));
+}
+
+static void noteEntry(Segment &seg, const IndexEntry &e)
+{
+  seg.entries++;
+  seg.last = e;
+  if (e.cycle >= seg.nextCycle)
   {
-    myFile = SD.open("/temperature/tempBaseline.csv", FILE_WRITE);
-    for (int i = 0; i < vector.size(); i++)
+    seg.nextCycle = e.cycle + 1;
+  }
+}
+
+static bool appendEntries(Mode mode, const IndexEntry *entries, size_t n, int32_t firstCycle)
+{
+  String path = indexPath(mode);
+  bool fresh = !SD.exists(path);
+  File myFile = SD.open(path, FILE_APPEND);
+  if (!myFile)
+  {
+    return false;
+  }
+  bool ok = true;
+  if (fresh)
+  {
+    IndexHeader header = {INDEX_MAGIC, sizeof(IndexEntry), firstCycle};
+    ok = myFile.write((const uint8_t *)&header, sizeof(header)) == sizeof(header);
+  }
+  ok = ok && myFile.write((const uint8_t *)entries, n * sizeof(IndexEntry)) == n * sizeof(IndexEntry);
+  myFile.close();
+  return ok;
+}
+
+// read the header and last entry, false if the index is missing or damaged
+static bool loadIndex(Mode mode, Segment &seg)
+{
+  String path = indexPath(mode);
+  if (!SD.exists(path))
+  {
+    return false;
+  }
+  File myFile = SD.open(path, FILE_READ);
+  if (!myFile)
+  {
+    return false;
+  }
+  IndexHeader header;
+  uint32_t size = myFile.size();
+  bool ok = size >= sizeof(header) && (size - sizeof(header)) % sizeof(IndexEntry) == 0 &&
+            myFile.read((uint8_t *)&header, sizeof(header)) == sizeof(header) &&
+            header.magic == INDEX_MAGIC && header.entrySize == sizeof(IndexEntry);
+  if (ok)
+  {
+    seg.entries = (size - sizeof(header)) / sizeof(IndexEntry);
+    seg.nextCycle = header.firstCycle;
+    if (seg.entries > 0)
     {
-      myFile.println(vector[i]);
+      myFile.seek(size - sizeof(IndexEntry));
+      ok = myFile.read((uint8_t *)&seg.last, sizeof(IndexEntry)) == sizeof(IndexEntry) && entryValid(seg.last);
+      seg.nextCycle = seg.last.cycle + 1;
+      seg.day = seg.last.day;
+      seg.index = seg.last.segment;
     }
-    myFile.close();
   }
-  else if (mode == VIBRATION)
+  myFile.close();
+  return ok;
+}
+
+// index every record on the card again, only when index.bin is missing or damaged
+static void rebuildIndex(Mode mode, Segment &seg)
+{
+  Serial.println("Rebuilding " + indexPath(mode));
+  std::vector<uint32_t> days;
+  File dir = SD.open(modeDir(mode));
+  File f = dir ? dir.openNextFile() : File();
+  while (f)
   {
-    myFile = SD.open("/vibration/vibrationBaseline.csv", FILE_WRITE);
-    for (int i = 0; i < vector.size(); i++)
+    String name = baseName(f);
+    if (f.isDirectory() && name.length() == 8)
     {
-      myFile.println(vector[i]);
+      days.push_back(name.toInt());
     }
-    myFile.close();
+    f.close();
+    f = dir.openNextFile();
+  }
+  dir.close();
+  std::sort(days.begin(), days.end());
+
+  seg.entries = 0;
+  seg.nextCycle = 0;
+  String tmpPath = indexPath(mode) + ".tmp";
+  SD.remove(tmpPath);
+  File out = SD.open(tmpPath, FILE_WRITE);
+  IndexHeader header = {INDEX_MAGIC, sizeof(IndexEntry), 0};
+  out.write((const uint8_t *)&header, sizeof(header));
+
+  auto indexSegment = [&](uint32_t day, int index) {
+    seg.day = day;
+    seg.index = index;
+    seg.size = scanSegment(segmentPath(mode, day, index), 0, [&](const RecordHeader &h, uint32_t pos, size_t len) {
+      IndexEntry e = makeEntry(h, day, index, pos, len);
+      out.write((const uint8_t *)&e, sizeof(e));
+      noteEntry(seg, e);
+    });
+  };
+  for (uint32_t day : days)
+  {
+    std::vector<int> files;
+    File dayDir = SD.open(dayPath(mode, day));
+    File g = dayDir ? dayDir.openNextFile() : File();
+    while (g)
+    {
+      String name = baseName(g);
+      if (segmentNumber(name) >= 0)
+      {
+        files.push_back(segmentNumber(name));
+      }
+      g.close();
+      g = dayDir.openNextFile();
+    }
+    dayDir.close();
+    std::sort(files.begin(), files.end());
+    for (int index : files)
+    {
+      indexSegment(day, index);
+    }
+  }
+
+  if (seg.entries == 0)
+  {
+    // cards written before the segments only have one csv file per cycle
+    seg.nextCycle = countFiles(mode);
+    header.firstCycle = seg.nextCycle;
+    out.seek(0);
+    out.write((const uint8_t *)&header, sizeof(header));
+  }
+  out.close();
+  SD.remove(indexPath(mode));
+  SD.rename(tmpPath, indexPath(mode));
+}
+
+// find the current segment the first time a mode is used
+static Segment &segmentFor(Mode mode)
+{
+  Segment &seg = segments[mode];
+  if (seg.loaded)
+  {
+    return seg;
+  }
+  seg.loaded = true;
+  seg.index = -1;
+  if (!loadIndex(mode, seg))
+  {
+    seg.index = -1;
+    rebuildIndex(mode, seg);
+  }
+  else if (seg.entries > 0)
+  {
+    // a reset between a segment write and its index entries leaves records
+    // past the last entry, always in the current segment
+    std::vector<IndexEntry> missed;
+    seg.size = scanSegment(segmentPath(mode, seg.day, seg.index), seg.last.offset + seg.last.length,
+                           [&](const RecordHeader &h, uint32_t pos, size_t len) {
+                             missed.push_back(makeEntry(h, seg.day, seg.index, pos, len));
+                           });
+    if (!missed.empty() && appendEntries(mode, missed.data(), missed.size(), 0))
+    {
+      for (const IndexEntry &e : missed)
+      {
+        noteEntry(seg, e);
+      }
+    }
+  }
+  if (seg.index >= 0 && seg.size >= SEGMENT_MAX_BYTES)
+  {
+    seg.index++;
+    seg.size = 0;
+  }
+  return seg;
+}
+
+// continue the newest segment of a day, or start its first one
+static void startDay(Mode mode, Segment &seg, uint32_t day)
+{
+  seg.day = day;
+  seg.index = 0;
+  seg.size = 0;
+  String path = dayPath(mode, day);
+  if (!SD.exists(path))
+  {
+    SD.mkdir(path);
+    return;
+  }
+  File dir = SD.open(path);
+  File f = dir ? dir.openNextFile() : File();
+  while (f)
+  {
+    int index = segmentNumber(baseName(f));
+    if (index >= seg.index)
+    {
+      seg.index = index;
+      seg.size = f.size();
+    }
+    f.close();
+    f = dir.openNextFile();
+  }
+  dir.close();
+  if (seg.size >= SEGMENT_MAX_BYTES)
+  {
+    seg.index++;
+    seg.size = 0;
+  }
+}
+
+static bool segmentWrite(Mode mode, Segment &seg, size_t len)
+{
+  String path = segmentPath(mode, seg.day, seg.index);
+  File myFile = SD.open(path, FILE_APPEND);
+  if (!myFile)
+  {
+    Serial.println("Failed to open " + path);
+    return false;
+  }
+  size_t written = myFile.write(seg.buf, len);
+  myFile.close();
+  seg.size += written;
+  return written == len;
+}
+
+bool appendRecord(Mode mode, const uint8_t *record, size_t len)
+{
+  Segment &seg = segmentFor(mode);
+  bool ok = true;
+  if (seg.pendingCount == INDEX_PENDING)
+  {
+    ok = flushData(mode);
+  }
+  RecordHeader h;
+  memcpy(&h, record, sizeof(h));
+  uint32_t day = dayOf(h.timestamp);
+  // records with no clock stay in the current day
+  if (seg.index < 0 || (day != 0 && day != seg.day))
+  {
+    ok = flushData(mode) && ok;
+    startDay(mode, seg, day);
+  }
+  seg.pending[seg.pendingCount++] = makeEntry(h, seg.day, seg.index, seg.size + seg.used, len);
+
+  while (len > 0)
+  {
+    size_t take = SEGMENT_BUFFER - seg.used;
+    if (take > len)
+    {
+      take = len;
+    }
+    memcpy(seg.buf + seg.used, record, take);
+    seg.used += take;
+    record += take;
+    len -= take;
+    if (seg.used == SEGMENT_BUFFER)
+    {
+      ok = segmentWrite(mode, seg, SEGMENT_BUFFER) && ok;
+      seg.used = 0;
+    }
+  }
+  return ok;
+}
+
+bool flushData(Mode mode)
+{
+  Segment &seg = segmentFor(mode);
+  bool ok = true;
+  if (seg.used > 0)
+  {
+    ok = segmentWrite(mode, seg, seg.used);
+    seg.used = 0;
+  }
+  if (seg.pendingCount > 0)
+  {
+    // index the records only once they are on the card
+    if (ok && appendEntries(mode, seg.pending, seg.pendingCount, seg.nextCycle))
+    {
+      for (size_t i = 0; i < seg.pendingCount; i++)
+      {
+        noteEntry(seg, seg.pending[i]);
+      }
+    }
+    seg.pendingCount = 0;
+  }
+  if (seg.size >= SEGMENT_MAX_BYTES)
+  {
+    seg.index++;
+    seg.size = 0;
+  }
+  return ok;
+}
+
+uint32_t recordTime()
+{
+  time_t now = time(nullptr);
+  // before the clock is set time() counts from 1970 at boot
+  return now > 1600000000 ? (uint32_t)now : millis() / 1000;
+}
+
+int nextCycle(Mode mode)
+{
+  return segmentFor(mode).nextCycle;
+}
+
+// a cycle's vibration feature vector as floats; temperatures are only
+// stored as series
+size_t encodeData(const float *values, size_t n, int cycle_num, uint8_t *out, size_t cap)
+{
+  return encodeRecord(out, cap, RECORD_FEATURES, ENCODING_FLOAT32, values, n, recordTime(), cycle_num, 0.0f);
+}
+
+size_t encodeSeries(Mode mode, const SeriesEncoder &series, int cycle_num, uint8_t *out, size_t cap)
+{
+  return encodeSeriesRecord(out, cap, (mode == TEMPERATURE) ? RECORD_TEMPERATURE : RECORD_FEATURES, series.data(),
+                            series.bytes(), series.count(), recordTime(), cycle_num);
+}
+
+size_t encodeSpectrum(const float *psd, int cycle_num, uint8_t *out, size_t cap)
+{
+  return encodeSpectrumRecord(out, cap, psd, SPECTRUM_BINS, haveSpectrumReference ? spectrumReference : nullptr,
+                              recordTime(), cycle_num, SPECTRUM_LOG_STEP);
+}
+
+void setSpectrumReference(const int16_t *codes)
+{
+  haveSpectrumReference = codes != nullptr;
+  if (codes)
+  {
+    memcpy(spectrumReference, codes, sizeof(spectrumReference));
   }
 }
 
@@ -161,102 +641,155 @@ std::vector<float> readBaseline(Mode mode)
   return {};
 }
 
-// return vectors from first 100 vibration files one at a time line159
-//  - storing standard deviation and retrieving it 2048
-std::vector<float> getVibrationBaseline()
+// binary checkpoints are journaled in two slots, <path>.a and <path>.b. Each
+// holds a header and the data, and a save overwrites the older slot, so a
+// reset in the middle of a write only ever damages the copy being replaced.
+// A load takes the intact slot with the highest sequence number.
+static const uint32_t CHECKPOINT_MAGIC = 0x4A504D43; // "CMPJ"
+
+struct CheckpointHeader
 {
-  File myFile;
-  bool possible = true;
-  for (int i = 0; i < 100; i++)
+  uint32_t magic;
+  uint32_t len;      // payload bytes, a file from another struct layout is rejected
+  uint32_t sequence; // incremented by every save
+  uint32_t crc;      // CRC-32 of the fields above and the payload
+};
+
+// newest slot of each checkpoint saved or loaded since boot
+#define CHECKPOINT_CACHE 8
+
+struct CheckpointState
+{
+  uint32_t key; // CRC-32 of the path
+  uint32_t sequence;
+  uint8_t slot;
+};
+
+static CheckpointState checkpointCache[CHECKPOINT_CACHE];
+static size_t checkpointCount = 0;
+
+static String slotPath(const char *path, int slot)
+{
+  return String(path) + (slot ? ".b" : ".a");
+}
+
+// true if a slot is complete and intact, streaming it through the CRC
+static bool slotValid(const String &path, size_t len, uint32_t &sequence)
+{
+  if (!SD.exists(path))
+  {
+    return false;
+  }
+  File myFile = SD.open(path, FILE_READ);
+  if (!myFile)
+  {
+    return false;
+  }
+  CheckpointHeader h;
+  bool ok = myFile.size() == sizeof(h) + len &&
+            myFile.read((uint8_t *)&h, sizeof(h)) == sizeof(h) &&
+            h.magic == CHECKPOINT_MAGIC && h.len == len;
+  uint32_t crc = crc32(&h, offsetof(CheckpointHeader, crc));
+  uint8_t chunk[128];
+  for (size_t done = 0; ok && done < len;)
   {
-    if (!SD.exists("/vibration/data" + String(i) + ".csv"))
+    size_t take = len - done < sizeof(chunk) ? len - done : sizeof(chunk);
+    ok = myFile.read(chunk, take) == take;
+    crc = crc32(chunk, take, crc);
+    done += take;
+  }
+  myFile.close();
+  if (ok && crc == h.crc)
+  {
+    sequence = h.sequence;
+    return true;
+  }
+  return false;
+}
+
+// newest intact slot, looked up on the card the first time
+static CheckpointState findCheckpoint(const char *path, size_t len)
+{
+  uint32_t key = crc32(path, strlen(path));
+  for (size_t i = 0; i < checkpointCount; i++)
+  {
+    if (checkpointCache[i].key == key)
     {
-      possible = false;
-      Serial.println("Error in vibration baseline: file " + String(i) + " does not exist");
-      break;
+      return checkpointCache[i];
     }
   }
-  if (possible)
+  CheckpointState state = {key, 0, 1}; // nothing saved yet, so slot a is written first
+  uint32_t sequence;
+  for (uint8_t slot = 0; slot < 2; slot++)
   {
-    // Serial.println("Attempting allocation of baseline vector");
-    std::vector<float> vector;
-    for (int i = 0; i < 2048; i++)
+    if (slotValid(slotPath(path, slot), len, sequence) && sequence >= state.sequence)
     {
-      vector.push_back(0);
+      state.sequence = sequence;
+      state.slot = slot;
     }
-    // Serial.println("Baseline vector allocated");
-    // int j = 0;
-    for (int i = 0; i < 100; i++)
-    {
-      // Serial.println("Attempting to read file "+String(i));
-      myFile = SD.open("/vibration/data" + String(i) + ".csv", FILE_READ);
+  }
+  return state;
+}
 
-      while (myFile.available() && vector.size() < 120)
-      {
-          String line =myFile.readStringUntil('\n');
-          line.trim();
-          if (line.length() > 0)
-          {
-            vector.push_back(line.toFloat());
-          }else{
-            vector.push_back(0.0f);
-          }
-      }
-    }
-    // Serial.println("Read all files");
-    for (int i = 0; i < vector.size(); i++)
+static void rememberCheckpoint(const CheckpointState &state)
+{
+  for (size_t i = 0; i < checkpointCount; i++)
+  {
+    if (checkpointCache[i].key == state.key)
     {
-      vector[i] /= 100;
+      checkpointCache[i] = state;
+      return;
     }
-    // Serial.println("Computed Baseline");
-    return vector;
   }
-  else
+  if (checkpointCount < CHECKPOINT_CACHE)
   {
-    return {{-1}};
+    checkpointCache[checkpointCount++] = state;
   }
 }
 
-// std Dev file for single standard deviation
-//  be able to retrieve - return std dev or -1 if
+bool saveBinary(const char *path, const void *data, size_t len)
+{
+  CheckpointState state = findCheckpoint(path, len);
+  uint8_t slot = 1 - state.slot;
+  String target = slotPath(path, slot);
+  File myFile = SD.open(target, FILE_WRITE);
+  if (!myFile)
+  {
+    Serial.println("Failed to open " + target);
+    return false;
+  }
+  CheckpointHeader h = {CHECKPOINT_MAGIC, (uint32_t)len, state.sequence + 1, 0};
+  h.crc = crc32(&h, offsetof(CheckpointHeader, crc));
+  h.crc = crc32(data, len, h.crc);
+  size_t written = myFile.write((const uint8_t *)&h, sizeof(h));
+  written += myFile.write((const uint8_t *)data, len);
+  myFile.close();
+  if (written != sizeof(h) + len)
+  {
+    // the other slot still holds the last good copy
+    return false;
+  }
+  state.sequence = h.sequence;
+  state.slot = slot;
+  rememberCheckpoint(state);
+  return true;
+}
 
-// read a vibration data file
-std::vector<float> readVibrationData(int i)
+bool loadBinary(const char *path, void *data, size_t len)
 {
-  File myFile;
-  // retrieve a vibration vector
-  if (!SD.exists("/vibration/data" + String(i) + ".csv"))
+  CheckpointState state = findCheckpoint(path, len);
+  if (state.sequence == 0)
   {
-    Serial.println("Vibration File Not Found");
-    return {0.0f};
+    return false;
   }
-  else
+  File myFile = SD.open(slotPath(path, state.slot), FILE_READ);
+  bool ok = myFile && myFile.seek(sizeof(CheckpointHeader)) && myFile.read((uint8_t *)data, len) == len;
+  myFile.close();
+  if (ok)
   {
-    // initialize an 2048-vector
-    std::vector<float> vector;
-    vector.reserve(2048);
-    myFile = SD.open("/vibration/data" + String(i) + ".csv");
-    while (myFile.available() && vector.size() < 2048)
-    {
-        String line =myFile.readStringUntil('\n');
-        line.trim();
-        if (line.length() > 0)
-        {
-          vector.push_back(line.toFloat());
-        }else{
-          vector.push_back(0.0f);
-        }
-    }
-    myFile.close();
-    // Serial.println("Printing");
-    // for(int i=0;i<vector.size();i++){
-    //   Serial.println(vector[i]);
-    // }
-    // Serial.println("Done printing");
-    //assert(vector.size()==2048);
-    // return the vector
-    return vector;
+    rememberCheckpoint(state);
   }
+  return ok;
 }
 
 
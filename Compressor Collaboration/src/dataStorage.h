@@ -4,6 +4,10 @@
 #include <vector>
 #include <SD.h>
 #include <cassert>
+#include "recordFormat.h"
+#include "spectrumCodec.h"
+#include "seriesCodec.h"
+#include "vibration.h"
 
 //extern File myFile; // use same myFile iteration
 
@@ -13,12 +17,28 @@ enum Mode {
 };
 
 int countFiles(Mode mode);
-void writeData(Mode mode, std::vector<float> vector, int cycle_num);
 
-void saveBaseline(Mode mode, std::vector<float> vector);
-std::vector<float> readBaseline(Mode mode);
-std::vector<float> getVibrationBaseline();
-std::vector<float> readVibrationData(int i);
+#define RECORD_MAX_BYTES (sizeof(RecordHeader) + SPECTRUM_BINS * sizeof(float))
+
+// binary records in append-only segment files, see recordFormat.h
+size_t encodeData(const float *values, size_t n, int cycle_num, uint8_t *out, size_t cap);
+// a cycle's timestamped readings as one record, see seriesCodec.h
+size_t encodeSeries(Mode mode, const SeriesEncoder &series, int cycle_num, uint8_t *out, size_t cap);
+// a cycle's spectrum, log quantized and delta coded, see spectrumCodec.h
+size_t encodeSpectrum(const float *psd, int cycle_num, uint8_t *out, size_t cap);
+// SPECTRUM_BINS codes spectra are coded against from now on, nullptr for bin to bin
+void setSpectrumReference(const int16_t *codes);
+bool appendRecord(Mode mode, const uint8_t *record, size_t len); // buffered
+bool flushData(Mode mode); // write what is buffered
+int nextCycle(Mode mode);  // cycle number after the last one stored
+uint32_t recordTime(); // record timestamp, seconds
+
+std::vector<float> readBaseline(Mode mode); // the old csv baselines, read once to import them
+
+// raw binary checkpoints of plain structs such as RunningStats, journaled in
+// two CRC-checked slots so a reset mid-write always leaves the last good copy
+bool saveBinary(const char *path, const void *data, size_t len);
+bool loadBinary(const char *path, void *data, size_t len); // newest intact copy
 
 void logPrintln(const String &msg);
 void logPrint(const String &msg);
@@ -0,0 +1,249 @@
+#ifndef FFTENGINE_H
+#define FFTENGINE_H
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+// Fixed-size FFT specialised on N at compile time.
+//
+// The twiddle factors and the bit-reversal permutation are computed by the
+// compiler and stored as const tables, which the ESP32 keeps in flash. A
+// transform therefore does no trig, no double precision math and no allocation.
+// Stages are done as radix-4 butterflies (one radix-2 stage first when log2(N)
+// is odd), which saves a quarter of the complex multiplies of a radix-2 FFT.
+
+namespace fft_detail
+{
+    constexpr double PI = 3.141592653589793238462643383279502884;
+
+    // Taylor series, accurate to double precision on [-pi, pi]
+    constexpr double taylorSin(double x)
+    {
+        double term = x;
+        double sum = x;
+        for (int i = 1; i < 16; i++)
+        {
+            term *= -x * x / ((2 * i) * (2 * i + 1));
+            sum += term;
+        }
+        return sum;
+    }
+
+    constexpr double taylorCos(double x)
+    {
+        double term = 1.0;
+        double sum = 1.0;
+        for (int i = 1; i < 16; i++)
+        {
+            term *= -x * x / ((2 * i - 1) * (2 * i));
+            sum += term;
+        }
+        return sum;
+    }
+
+    constexpr size_t log2(size_t n)
+    {
+        return n <= 1 ? 0 : 1 + log2(n >> 1);
+    }
+
+    template <size_t N>
+    struct Tables
+    {
+        static_assert(N >= 4 && (N & (N - 1)) == 0, "FFT size must be a power of two");
+        static_assert(N <= 65536, "bit-reversal table is 16 bit");
+
+        // W_N^k = exp(-2*pi*i*k/N) for k < 3N/4, the largest index a radix-4 stage uses
+        float wr[3 * N / 4];
+        float wi[3 * N / 4];
+        uint16_t rev[N];
+
+        constexpr Tables() : wr(), wi(), rev()
+        {
+            for (size_t k = 0; k < 3 * N / 4; k++)
+            {
+                double angle = -2.0 * PI * (double)k / (double)N;
+                if (angle < -PI)
+                {
+                    angle += 2.0 * PI;
+                }
+                wr[k] = (float)taylorCos(angle);
+                wi[k] = (float)taylorSin(angle);
+            }
+            for (size_t i = 0; i < N; i++)
+            {
+                size_t r = 0;
+                for (size_t b = 0; b < log2(N); b++)
+                {
+                    r |= ((i >> b) & 1) << (log2(N) - 1 - b);
+                }
+                rev[i] = (uint16_t)r;
+            }
+        }
+    };
+
+    template <size_t N>
+    struct TableHolder
+    {
+        static constexpr Tables<N> value{};
+    };
+
+    template <size_t N>
+    constexpr Tables<N> TableHolder<N>::value;
+
+    // W_N^k for k <= N/4, used to split a packed real transform
+    template <size_t N>
+    struct RealTables
+    {
+        float wr[N / 4 + 1];
+        float wi[N / 4 + 1];
+
+        constexpr RealTables() : wr(), wi()
+        {
+            for (size_t k = 0; k <= N / 4; k++)
+            {
+                double angle = -2.0 * PI * (double)k / (double)N;
+                wr[k] = (float)taylorCos(angle);
+                wi[k] = (float)taylorSin(angle);
+            }
+        }
+    };
+
+    template <size_t N>
+    struct RealTableHolder
+    {
+        static constexpr RealTables<N> value{};
+    };
+
+    template <size_t N>
+    constexpr RealTables<N> RealTableHolder<N>::value;
+}
+
+template <size_t N>
+class FFTEngine
+{
+public:
+    // in-place forward transform of N complex samples
+    static void forward(std::complex<float> *x)
+    {
+        const fft_detail::Tables<N> &t = fft_detail::TableHolder<N>::value;
+        // std::complex<float> is guaranteed to be laid out as float[2]
+        float *v = reinterpret_cast<float *>(x);
+
+        for (size_t i = 0; i < N; i++)
+        {
+            size_t j = t.rev[i];
+            if (i < j)
+            {
+                std::swap(x[i], x[j]);
+            }
+        }
+
+        size_t m = 1;
+        if (fft_detail::log2(N) & 1)
+        {
+            for (size_t i = 0; i < 2 * N; i += 4)
+            {
+                float ar = v[i], ai = v[i + 1];
+                float br = v[i + 2], bi = v[i + 3];
+                v[i] = ar + br;
+                v[i + 1] = ai + bi;
+                v[i + 2] = ar - br;
+                v[i + 3] = ai - bi;
+            }
+            m = 2;
+        }
+
+        // each pass merges four DFTs of size m into one of size 4m
+        for (; m < N; m <<= 2)
+        {
+            const size_t len = m << 2;
+            const size_t stride = N / len;
+            for (size_t j = 0; j < m; j++)
+            {
+                const float w1r = t.wr[j * stride], w1i = t.wi[j * stride];
+                const float w2r = t.wr[2 * j * stride], w2i = t.wi[2 * j * stride];
+                const float w3r = t.wr[3 * j * stride], w3i = t.wi[3 * j * stride];
+                for (size_t base = j; base < N; base += len)
+                {
+                    float *p0 = v + 2 * base;
+                    float *p1 = p0 + 2 * m;
+                    float *p2 = p1 + 2 * m;
+                    float *p3 = p2 + 2 * m;
+
+                    // the second quarter takes W^2j and the third W^j because the
+                    // input is in radix-2 bit-reversed order
+                    float ar = p0[0], ai = p0[1];
+                    float br = p1[0] * w2r - p1[1] * w2i, bi = p1[0] * w2i + p1[1] * w2r;
+                    float cr = p2[0] * w1r - p2[1] * w1i, ci = p2[0] * w1i + p2[1] * w1r;
+                    float dr = p3[0] * w3r - p3[1] * w3i, di = p3[0] * w3i + p3[1] * w3r;
+
+                    float s0r = ar + br, s0i = ai + bi;
+                    float s1r = ar - br, s1i = ai - bi;
+                    float s2r = cr + dr, s2i = ci + di;
+                    float s3r = cr - dr, s3i = ci - di;
+
+                    p0[0] = s0r + s2r;
+                    p0[1] = s0i + s2i;
+                    p2[0] = s0r - s2r;
+                    p2[1] = s0i - s2i;
+                    // -i * s3 = (s3i, -s3r)
+                    p1[0] = s1r + s3i;
+                    p1[1] = s1i - s3r;
+                    p3[0] = s1r - s3i;
+                    p3[1] = s1i + s3r;
+                }
+            }
+        }
+    }
+};
+
+// Transform of N real samples using one N/2 point complex FFT.
+//
+// The even samples are packed as real parts and the odd samples as imaginary
+// parts, transformed with FFTEngine<N/2>, then split into the spectrum of the
+// real signal. Only bins 0..N/2 are produced since the rest are their complex
+// conjugates.
+template <size_t N>
+class RealFFTEngine
+{
+public:
+    static const size_t BINS = N / 2 + 1;
+
+    // x holds N real samples and must have room for N + 2 floats. On return it
+    // holds BINS complex values as interleaved re/im pairs.
+    static void forward(float *x)
+    {
+        const size_t M = N / 2;
+        const fft_detail::RealTables<N> &t = fft_detail::RealTableHolder<N>::value;
+        FFTEngine<M>::forward(reinterpret_cast<std::complex<float> *>(x));
+
+        float z0r = x[0], z0i = x[1];
+        x[0] = z0r + z0i;
+        x[1] = 0.0f;
+        x[2 * M] = z0r - z0i;
+        x[2 * M + 1] = 0.0f;
+
+        // bins k and M-k are built from the same pair of packed values
+        for (size_t k = 1; k <= M / 2; k++)
+        {
+            float *pk = x + 2 * k;
+            float *pm = x + 2 * (M - k);
+            // spectra of the even (e) and odd (o) samples
+            float er = 0.5f * (pk[0] + pm[0]), ei = 0.5f * (pk[1] - pm[1]);
+            float orr = 0.5f * (pk[1] + pm[1]), oi = -0.5f * (pk[0] - pm[0]);
+            float tr = orr * t.wr[k] - oi * t.wi[k];
+            float ti = orr * t.wi[k] + oi * t.wr[k];
+            pk[0] = er + tr;
+            pk[1] = ei + ti;
+            if (pm != pk)
+            {
+                pm[0] = er - tr;
+                pm[1] = ti - ei;
+            }
+        }
+    }
+};
+
+#endif
@@ -1,57 +1,209 @@
 #include <Arduino.h>
-#include <SD.h>
-#include <SPI.h>
-#include <vector>
 #include <OneWire.h>
 #include "getTemp.h"
 
 //getTemp function courtesy of the people that wrote it.
 
-float getTemp() {
-  //returns the temperature from one DS18S20 in DEG Celsius
+static TempReadings readings;     // ROM codes found by tempBegin() and their latest values
+static TempResolution resolution = TEMP_RES_12;
+static unsigned long conversionMs = 750; // time the slowest probe needs for a conversion
+static bool converting = false;
+static unsigned long conversionStart = 0;
 
-  byte data[12];
+bool tempBegin(TempResolution res) {
   byte addr[8];
+  char id[17];
 
-  if ( !ds.search(addr)) {
-      //no more sensors on chain, reset search
-      ds.reset_search();
-      return -1000;
-  }
+  resolution = res;
+  conversionMs = 750UL >> (TEMP_RES_12 - resolution);
+  converting = false;
+  readings.count = 0;
+  readings.time = 0;
 
-  if ( OneWire::crc8( addr, 7) != addr[7]) {
-      Serial.println("CRC is not valid!");
-      return -1000;
+  ds.reset_search();
+  while (readings.count < TEMP_MAX_PROBES && ds.search(addr)) {
+    if ( OneWire::crc8( addr, 7) != addr[7]) {
+        Serial.println("CRC is not valid!");
+        continue;
+    }
+    if ( addr[0] != 0x10 && addr[0] != 0x28) {
+        continue;
+    }
+    TempProbe &p = readings.probe[readings.count++];
+    memcpy(p.rom, addr, sizeof(p.rom));
+    p.temp = -1000;
+    p.status = TEMP_NO_SENSOR;
+    memset(&p.health, 0, sizeof(p.health));
+    tempRomString(addr, id);
+    Serial.println("Temperature probe " + String(readings.count - 1) + ": " + String(id));
+
+    if (addr[0] == 0x28) {
+      // write TH, TL and the configuration register holding the resolution
+      ds.reset();
+      ds.select(addr);
+      ds.write(0x4E);
+      ds.write(0x4B);
+      ds.write(0x46);
+      ds.write(((resolution - 9) << 5) | 0x1F);
+    } else {
+      conversionMs = 750; // the DS18S20 always takes the full conversion time
+    }
   }
-
-  if ( addr[0] != 0x10 && addr[0] != 0x28) {
-      Serial.print("Device is not recognized");
-      return -1000;
+  ds.reset_search();
+  if (readings.count == 0) {
+      Serial.println("No temperature sensor found");
+      return false;
   }
 
+  tempRequest();
+  return true;
+}
+
+void tempRequest() {
+  if (readings.count == 0) {
+    return;
+  }
   ds.reset();
-  ds.select(addr);
+  ds.skip();        // every probe converts at once
   ds.write(0x44,1); // start conversion, with parasite power on at the end
+  conversionStart = millis();
+  converting = true;
+}
+
+bool tempReady() {
+  return converting && millis() - conversionStart >= conversionMs;
+}
+
+// one attempt at a probe's scratchpad, temp in DEG F when TEMP_OK
+static TempStatus readScratchpad(const byte *addr, float &temp) {
+  byte data[12];
 
-  byte present = ds.reset();
+  if (!ds.reset()) {
+    return TEMP_TIMEOUT; // no presence pulse
+  }
   ds.select(addr);
   ds.write(0xBE); // Read Scratchpad
 
-
   for (int i = 0; i < 9; i++) { // we need 9 bytes
     data[i] = ds.read();
   }
+  if (OneWire::crc8(data, 8) != data[8]) {
+    return TEMP_CRC_ERROR;
+  }
 
-  ds.reset_search();
+  int16_t raw = (data[1] << 8) | data[0]; //using two's compliment
+  if (addr[0] == 0x10) {
+    raw = raw << 3; // 9 bit resolution, 0.5 C per count
+  } else {
+    // bits below the resolution are undefined
+    raw &= ~((1 << (TEMP_RES_12 - resolution)) - 1);
+  }
+  float TemperatureSum = (float)raw / 16;
 
-  byte MSB = data[1];
-  byte LSB = data[0];
+  TemperatureSum = (TemperatureSum * 1.8) + 32;
 
-  float tempRead = ((MSB << 8) | LSB); //using two's compliment
-  float TemperatureSum = tempRead / 16;
+  if (TemperatureSum < TEMP_MIN_F || TemperatureSum > TEMP_MAX_F) {
+    return TEMP_OUT_OF_RANGE;
+  }
+  temp = TemperatureSum;
+  return TEMP_OK;
+}
+
+// retries a probe within the time budget, keeps the last good value on failure
+static void readProbe(TempProbe &p) {
+  unsigned long start = millis();
+  TempStatus status = TEMP_TIMEOUT;
+  float temp = p.temp;
+
+  p.health.reads++;
+  for (int attempt = 0; attempt < TEMP_READ_RETRIES; attempt++) {
+    status = readScratchpad(p.rom, temp);
+    if (status == TEMP_OK) {
+      break;
+    }
+    if (status == TEMP_CRC_ERROR) {
+      p.health.crcErrors++;
+    } else if (status == TEMP_OUT_OF_RANGE) {
+      p.health.rangeErrors++;
+    } else {
+      p.health.timeouts++;
+    }
+    if (millis() - start >= TEMP_READ_BUDGET_MS) {
+      break;
+    }
+  }
+  p.status = status;
+  if (status == TEMP_OK) {
+    p.temp = temp;
+  }
+}
 
-  TemperatureSum = (TemperatureSum * 1.8) + 32;
+float tempRead() {
+  converting = false;
+  if (readings.count == 0) {
+    return -1000;
+  }
+  for (size_t i = 0; i < readings.count; i++) {
+    readProbe(readings.probe[i]);
+  }
+  readings.time = conversionStart;
+  return readings.probe[0].temp;
+}
+
+const TempReadings &tempReadings() {
+  return readings;
+}
+
+size_t tempProbeCount() {
+  return readings.count;
+}
+
+void tempRomString(const byte *rom, char *out) {
+  static const char hex[] = "0123456789ABCDEF";
+  for (int i = 0; i < 8; i++) {
+    out[2 * i] = hex[rom[i] >> 4];
+    out[2 * i + 1] = hex[rom[i] & 0x0F];
+  }
+  out[16] = '\0';
+}
+
+TempStatus getTemp(float &temp) {
+  if (tempReady()) {
+    tempRead();
+    tempRequest();
+  } else if (!converting) {
+    tempRequest();
+  }
+  if (readings.count == 0) {
+    temp = -1000;
+    return TEMP_NO_SENSOR;
+  }
+  temp = readings.probe[0].temp;
+  return readings.probe[0].status;
+}
 
-  return TemperatureSum;
+float tempCelsius(float fahrenheit) {
+  return roundf((fahrenheit - 32) / 1.8 * 16) / 16;
+}
 
-}
\ No newline at end of file
+float getTemp() {
+  float temp;
+  getTemp(temp);
+  return temp;
+}
+
+String tempHealthSummary() {
+  String summary = "";
+  for (size_t i = 0; i < readings.count; i++) {
+    const TempHealth &h = readings.probe[i].health;
+    if (h.crcErrors == 0 && h.rangeErrors == 0 && h.timeouts == 0) {
+      continue;
+    }
+    if (summary.length() > 0) {
+      summary += "; ";
+    }
+    summary += "P" + String(i) + " crc " + String(h.crcErrors) + ", range " + String(h.rangeErrors) +
+               ", timeout " + String(h.timeouts) + " of " + String(h.reads);
+  }
+  return summary;
+}
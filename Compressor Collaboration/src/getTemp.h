@@ -1,8 +1,98 @@
 #ifndef GETTEMP_H
 #define GETTEMP_H
 
+#include <Arduino.h>
 #include <OneWire.h>
 
 extern OneWire ds;   // Declare, not define so that its only used once
+
+#define TEMP_MAX_PROBES 4 // suction, discharge, condenser and ambient
+#define TEMP_MIN_F 30.0f        // readings outside this range are rejected
+#define TEMP_MAX_F 175.0f
+#define TEMP_READ_BUDGET_MS 40  // time one probe may spend on retries
+#define TEMP_READ_RETRIES 3
+
+// DS18B20 resolution in bits, higher takes longer to convert
+enum TempResolution
+{
+    TEMP_RES_9 = 9,   //  93.75 ms, 0.5 C steps
+    TEMP_RES_10 = 10, // 187.5 ms, 0.25 C steps
+    TEMP_RES_11 = 11, // 375 ms, 0.125 C steps
+    TEMP_RES_12 = 12  // 750 ms, 0.0625 C steps
+};
+
+// outcome of the last read of a probe
+enum TempStatus
+{
+    TEMP_OK,
+    TEMP_CRC_ERROR,    // scratchpad CRC never matched
+    TEMP_OUT_OF_RANGE, // valid scratchpad but outside TEMP_MIN_F..TEMP_MAX_F
+    TEMP_TIMEOUT,      // no presence pulse within the time budget
+    TEMP_NO_SENSOR     // nothing found or nothing read yet
+};
+
+// failure counters since tempBegin(), one attempt can count more than once
+struct TempHealth
+{
+    uint32_t reads;
+    uint32_t crcErrors;
+    uint32_t rangeErrors;
+    uint32_t timeouts;
+};
+
+struct TempProbe
+{
+    byte rom[8];       // 1-Wire ROM code, the probe's identity
+    float temp;        // last good reading in degrees F, -1000 if there is none
+    TempStatus status; // of the most recent read, temp is stale unless TEMP_OK
+    TempHealth health;
+};
+
+// one conversion of every probe on the bus
+struct TempReadings
+{
+    unsigned long time; // millis() when the conversion was started
+    size_t count;
+    TempProbe probe[TEMP_MAX_PROBES];
+};
+
+/*
+ * Non-blocking driver for several DS18x20 probes sharing TEMP_PIN.
+ *
+ * tempBegin() searches the bus once and caches every probe's ROM code, in
+ * search order. tempRequest() starts a conversion on all of them at once
+ * with a Skip ROM broadcast, and once tempReady() says the conversion time
+ * has passed tempRead() collects each probe's scratchpad by its ROM code.
+ * Reading N probes takes one conversion period, and nothing here waits for
+ * the sensors.
+ *
+ * Each scratchpad read is CRC checked and range checked and retried within
+ * TEMP_READ_BUDGET_MS. A probe that still fails keeps its last good value
+ * and reports why in its status and health counters, so a bad probe makes
+ * the data stale instead of stalling the caller.
+ */
+bool tempBegin(TempResolution res); // false if no probe was found
+void tempRequest();
+bool tempReady();
+float tempRead(); // reads every probe, returns the first one's last good temperature
+
+// every probe from the most recent completed conversion, keyed by ROM code
+const TempReadings &tempReadings();
+size_t tempProbeCount();
+void tempRomString(const byte *rom, char *out); // 16 hex digits, out holds 17
+
+// latest reading of the first probe in degrees F without waiting. Collects a
+// finished conversion and starts the next one, -1000 until the first one is done.
+// Called every loop() pass, so a reading is at most one conversion time plus
+// one pass old; tempReadings().time says when it was taken
 float getTemp();
+// same, also telling whether the value is fresh
+TempStatus getTemp(float &temp);
+
+// a reading in the sensor's own units, degrees C in 1/16 steps, which the
+// stored series compress best in
+float tempCelsius(float fahrenheit);
+
+// "" while every probe is healthy, otherwise its failure counters for telemetry
+String tempHealthSummary();
 #endif
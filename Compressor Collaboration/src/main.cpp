@@ -7,11 +7,16 @@
 
 // include header files
 #include "getTemp.h"
-#include "tempClean.h"
 #include "tempAnalysis.h"
 #include "dataStorage.h"
+#include "storage.h"
 #include "communication.h"
 #include "vibration.h"
+#include "acquisition.h"
+#include "welch.h"
+#include "toneTracker.h"
+#include "runningStats.h"
+#include "slopeAccumulator.h"
 #include "compressorDetect.h"
 #include <SafeQueue.h>
 #include <mutex>
@@ -28,6 +33,15 @@
 
 #define LED 2
 
+#define VIB_REPORT_MS 5000 // live vibration telemetry interval
+#define VIBRATION_BASELINE_CYCLES 100 // cycles averaged into the vibration baseline
+#define VIBRATION_STATS_PATH "/vibration/featureStats.bin"
+#define SPECTRUM_BASELINE_PATH "/vibration/spectrumBaseline.bin"
+#define TEMP_BASELINE_MIN_CYCLES 100 // cycles before temperature trends are scored
+#define TEMP_BASELINE_CYCLES 800 // cycles folded into the slope baseline
+#define TEMP_BASELINE_PATH "/temperature/slopeBaseline.bin"
+#define CYCLE_TICKS 120 // 5 s temperature ticks collected per cycle, 10 minutes
+
 // Global
 int state = 1; // TODO change back
 int cycleNum = 0;
@@ -43,6 +57,7 @@ enum communicationControl
 SafeQueue<communicationControl> com_control_queue;
 SafeQueue<float> vibrationQueue;
 SafeQueue<float> tempQueue;
+SafeQueue<String> detailQueue;
 SafeQueue<String> messageQueue;
 TaskHandle_t comm_handle;
 mutex control_lock;
@@ -52,25 +67,32 @@ bool temperatureBaselineExists = false;
 
 // For temperatures
 OneWire ds(TEMP_PIN);
-int temperature_sensor_timer = 0;
-int total_time = 0;
-std::vector<float> baselineSlopes;
-std::vector<float> temperatures;
-bool tempCleaned = 0;
+unsigned long lastTempSample = 0;
+int cycleTicks = 0; // temperature ticks of this cycle, counted whether or not the read worked
+SlopeBaseline slopeBaseline;
+SeriesEncoder temperatures; // this cycle's readings, compressed as they arrive
+SlopeAccumulator cycleSlope; // least-squares fit of this cycle's temperatures so far
 float tempZScore = 0;
-std::vector<float> temperatureChecking;
+CompressorDetector compressorDetect; // vibration and temperature on/off detection
 
 // For Storage
 // File myFile;
 
 // For vibration
-CArray data;
-vector<float> vibrationBaseline;
-float vibrationSTD = -1.0f;
+WelchAccumulator welch; // averaged spectrum of the current compressor cycle
+ToneTracker tones(VIBRATION_SAMPLE_RATE, LINE_FREQUENCY, TONE_HARMONICS); // live line frequency harmonics
+unsigned long lastVibReport = 0;
+// fixed buffers so the block to score path never touches the heap
+float cyclePsd[SPECTRUM_BINS];
+float cycleFeatures[FEATURE_COUNT];
+RunningStats<FEATURE_COUNT> vibrationStats; // baseline mean and variance of every feature
+SpectrumReference<SPECTRUM_BINS> spectrumBaseline; // archived spectra are coded against this
+int16_t spectrumCodes[SPECTRUM_BINS];
+static_assert(sizeof(SpectrumReference<SPECTRUM_BINS>) <= STORAGE_SLOT_BYTES, "spectrum baseline must fit a storage buffer");
+AnomalyScore vibrationScore;
+String vibrationDetail = "";
 int TotalVibrationCycles = 0; // number of vibration cycles total
-float vibRead;
 float cycleSTD = 0.0f;
-int numVibrationCyclesInSTDCalculation = 0; // number of vibration cycles in current standard deviation calculation
 
 void communicationTask(void *args)
 {
@@ -78,6 +100,7 @@ void communicationTask(void *args)
   float vibration = 0;
   String tempStr;
   String vibStr;
+  String detail;
   control_lock.lock(); // the thread must own the lock before unlocking it, otherwise the entire program could be corrupted due to UB
   while (true)
   {
@@ -103,7 +126,8 @@ void communicationTask(void *args)
     case STATUSCHECK:
       temperature = tempQueue.dequeue();
       vibration = vibrationQueue.dequeue();
-      statusCheck(temperature, vibration, lastStatus);
+      detail = detailQueue.dequeue();
+      statusCheck(temperature, vibration, lastStatus, detail);
       break;
     }
   }
@@ -145,6 +169,14 @@ void setup()
   }
   logPrintln("\nConnected!");
 
+  // UTC from NTP, records are timestamped and filed by day with it
+  configTime(0, 0, "pool.ntp.org");
+  struct tm now;
+  if (!getLocalTime(&now, 10000))
+  {
+    logPrintln("Clock not set, records are timed from boot");
+  }
+
   preferencesStartup(false); // true - new , false - not new
 
   logPrintln("status: " + String(msgStatusId) + " temp: " + String(msgTempId) + " vib: " + String(msgVibId) + " alert: " + String(msgAlertId));
@@ -154,6 +186,14 @@ void setup()
   pinMode(TEMP_PIN, INPUT);
   pinMode(PIEZO_PIN, INPUT);
   pinMode(LED, OUTPUT); // for debuging
+  if (!tempBegin(TEMP_RES_12))
+  {
+    logPrintln("Temperature sensor not found");
+  }
+  if (!acquisitionBegin())
+  {
+    logPrintln("Vibration acquisition failed to start");
+  }
 
   logPrintln("\n=== SD Card Diagnostics ===");
   String words = "Free heap: %d bytes\n" + String(ESP.getFreeHeap());
@@ -163,36 +203,59 @@ void setup()
   logPrint(words);
   logPrintln("Card Mount Successful");
   logPrintln("free heap:" + String(esp_get_free_heap_size()));
-  // check if baselines exist
-  File myFile;
-  if (!SD.exists("/temperature/tempBaseline.csv"))
-  {
-    myFile = SD.open("/temperature/tempBaseline.csv", FILE_WRITE);
-    myFile.close();
-  }
-  if (!SD.exists("/vibration/vibrationBaseline.csv"))
-  {
-    myFile = SD.open("/vibration/vibrationBaseline.csv", FILE_WRITE);
-    myFile.close();
-  }
   // load standard deviations if baselines exist (i.e. after power failure, recompute standard deviations). If the standard deviation file doesn't exist, return -1
   // if (!SD.exists("/vbration/stdDev.csv")) {
   //   myFile = SD.open("/vibration/stdDev.csv", FILE_WRITE);
   //   myFile.close();
   // }
   xTaskCreatePinnedToCore(communicationTask, "COMMS", 8192, NULL, 0, &comm_handle, 0);
+  if (!storageBegin())
+  {
+    logPrintln("Storage task failed to start");
+  }
   // count the number of data files to find how many cycles have occurred
-  TotalVibrationCycles = countFiles(VIBRATION);
-  cycleNum = countFiles(TEMPERATURE);
-  vibrationBaseline = readBaseline(VIBRATION);
-  if (vibrationBaseline.size() > 0)
+  TotalVibrationCycles = nextCycle(VIBRATION);
+  cycleNum = nextCycle(TEMPERATURE);
+  // the baseline statistics are kept up to date on the card, so no data files need reading
+  if (!loadBinary(VIBRATION_STATS_PATH, &vibrationStats, sizeof(vibrationStats)))
   {
-    vibrationBaselineExists = true;
+    vibrationStats.reset();
   }
+  vibrationBaselineExists = vibrationStats.count >= VIBRATION_BASELINE_CYCLES;
+  logPrintln("Vibration baseline cycles: " + String(vibrationStats.count));
+  if (!loadBinary(SPECTRUM_BASELINE_PATH, &spectrumBaseline, sizeof(spectrumBaseline)))
+  {
+    spectrumBaseline.reset();
+  }
+  if (spectrumBaseline.count >= VIBRATION_BASELINE_CYCLES)
+  {
+    spectrumBaseline.codes(spectrumCodes);
+    setSpectrumReference(spectrumCodes);
+  }
+  if (!loadBinary(TEMP_BASELINE_PATH, &slopeBaseline, sizeof(slopeBaseline)))
+  {
+    // carry over a baseline from the old csv file once
+    slopeBaseline.reset();
+    std::vector<float> oldSlopes = readBaseline(TEMPERATURE);
+    for (float slope : oldSlopes)
+    {
+      slopeBaseline.add(slope);
+    }
+    if (!oldSlopes.empty())
+    {
+      saveBinary(TEMP_BASELINE_PATH, &slopeBaseline, sizeof(slopeBaseline));
+    }
+  }
+  temperatureBaselineExists = slopeBaseline.stats.count >= TEMP_BASELINE_MIN_CYCLES;
+  logPrintln("Temperature baseline cycles: " + String(slopeBaseline.stats.count));
 }
 
 void loop()
 {
+  // the detectors follow vibration and temperature in every state, so their
+  // references never go stale while a cycle is collected
+  Transition transition = compressorDetect.update();
+
   // ------------------------STATE 1------------------------ //
 
   if (state == 1) // rest state, waiting for compressor to turn on
@@ -202,8 +265,7 @@ void loop()
     // logPrint("Vibration:     ");
     // logPrint(vib);
     // logPrint("      \r");
-    temperatureChecking = simpleTempDetect();
-    if (temperatureChecking.size() != 1) // TODO see if this temp function works and maybe change back compressorRunning(false)
+    if (transition == TRANSITION_ON)
     // keep the line below commented or else who knows what could happen
     //  updateMessage(msgStatusId, "Fridge Compressor 1 Status: " + lastStatus + " (collecting)");
     {
@@ -215,133 +277,93 @@ void loop()
       logPrintln(String(msgStatusId) + " " + lastStatus);
       control_lock.unlock();
       state = 2;
+      acquisitionRestart(compressorDetect.samplesSinceChange()); // first block starts where the change began
+      lastTempSample = millis();
+      cycleTicks = 0;
+      cycleSlope.reset();
       digitalWrite(LED, HIGH);
       logPrintln("Changed to State 2");
-      logPrint("Temp vector returned: ");
-      for (int i = 0; i < temperatureChecking.size(); i++)
-      {
-        logPrint(String(temperatureChecking[i]) + ", ");
-      }
+      logPrintln("Detection confidence: " + String(compressorDetect.confidence(), 1));
     }
-    temperatureChecking.clear();
-    temperatureChecking.shrink_to_fit();
+    delay(1); // detection returns immediately, let lower priority tasks run
   }
 
   // ------------------------STATE 2------------------------ //
 
   else if (state == 2) // data collecting state, collecing data unticmpressor turns off
   {
-    // record vibration every 5ms
-    //  temperature_sensor_timer=1000000;
-    if (temperature_sensor_timer >= 5000)
+    // vibration is sampled in the background, blocks are picked up below
+    if (millis() - lastTempSample >= 5000)
     { // record temperature every 5 seconds
-      float temp = getTemp();
-      while (temp < 30 || temp > 175)
+      float temp;
+      TempStatus tempStatus = getTemp(temp);
+      if (tempStatus != TEMP_OK)
+      {
+        // a bad probe costs this sample, not the vibration sampling
+        logPrintln("Temperature read failed (" + String(tempStatus) + "), sample skipped");
+      }
+      else
       {
-        temp = getTemp(); // might cause issues
+        temperatures.add(recordTime(), tempCelsius(temp));
+        cycleSlope.add(cycleTicks, temp);
       }
-      temperatures.push_back(temp);
-      temperature_sensor_timer = 0;
+      lastTempSample += 5000;
+      cycleTicks++;
     }
-    if (store_vibration())
+    const float *block = acquisitionBlock();
+    if (block)
     {
-      // store the vibrations to the data vector and compute the FFT when ready
-      fft(data);
-      vector<float> transform = magnitude(data);
-      erase();
-      logPrintln("Transform calculated");
-
-      // find max for the transform
-      float Max = 0.0;
-      int j = 0;
-      for (int i = 20; i < transform.size() / 2; i++)
+      // fold the block into the live harmonics and the cycle's averaged spectrum
+      for (int i = 0; i < FFT_SIZE; i++)
       {
-        if (transform[i] > Max)
-        {
-          j = i;
-          Max = transform[i];
-        }
+        tones.push(block[i]);
       }
-      String tempStr = String(getTemp(), 1) + "°F";           // one decimal
-      String vibStr = String((((float)j) / 2048 * 200) + 56) + "Hz"; // three decimals  j*1/2048*200
-      // updateDataMessages(tempStr, lastTempStr, vibStr, lastVibStr);
+      welch.addSamples(block, FFT_SIZE);
+      acquisitionRelease();
+    }
+    if (tones.ready() && millis() - lastVibReport >= VIB_REPORT_MS)
+    {
+      // report the strongest harmonic, no transform needed
+      size_t k = tones.strongest();
+      String tempStr = String(getTemp(), 1) + "°F";                                                  // one decimal
+      if (temperatureBaselineExists && cycleSlope.count >= 3)
+      {
+        // the fit is available mid-cycle, so the temperature trend can be scored early
+        tempStr += " (slope z " + String(tempAnalysis(slopeBaseline, cycleSlope.slope()), 1) + ")";
+      }
+      String tempHealth = tempHealthSummary();
+      if (tempHealth.length() > 0)
+      {
+        tempStr += " [" + tempHealth + "]";
+      }
+      String vibStr = String(tones.frequency(k), 1) + "Hz (" + String(tones.amplitude(k), 1) + ")"; // amplitude in ADC counts
       control_lock.lock();
       messageQueue.enqueue(tempStr);
       messageQueue.enqueue(vibStr);
       com_control_queue.enqueue(UPDATEDATAMESSAGES);
       control_lock.unlock();
+      lastVibReport = millis();
       logPrintln("Updating vibration messages");
-
-      // save the data
-      writeData(VIBRATION, transform, TotalVibrationCycles);
-      logPrintln("Transform saved as file" + String(TotalVibrationCycles));
-      // The data vector is ready for another cycle, and the transform vector is ready for analysis
-      if (vibrationBaselineExists)
-      {
-        // compare current vibration to baseline
-        if (vibrationSTD < 0)
-        {
-          // compare old files and compute vibration standard deviation. This can be recomputed every time the system restarts
-          vector<float> old;
-          old.reserve(2048);
-          logPrintln("Attempting VSTD calc");
-          for (int i = 0; i < 100; i++)
-          {
-            old.clear();
-            // logPrintln("Attempting to read file "+String(i));
-            old = readVibrationData(i);
-            if (old.size() != 2048)
-            {
-              logPrintln("Vibration vector was not of the correct size");
-              continue;
-            }
-            vibrationSTD += compare(vibrationBaseline, old);
-            // logPrintln(String(vibrationSTD));
-          }
-          vibrationSTD = vibrationSTD > 0 ? pow(vibrationSTD / 100, 0.5f) : -1;
-          logPrintln("Vibration Standard Deviation Calculated: " + String(vibrationSTD));
-        }
-        cycleSTD += vectorsize(vectordifference(vibrationBaseline, transform)) / vibrationSTD;
-        numVibrationCyclesInSTDCalculation++;
-        logPrintln("Vibration std dev of current recording amassed in running total");
-      }
-      else
-      {
-        // construct baseline and save
-        if (TotalVibrationCycles >= 100)
-        {
-          // logPrintln("Attemptint to calculate the vibration baseline");
-          vibrationBaseline = getVibrationBaseline();
-          if (vibrationBaseline.size() > 2)
-          {
-            // logPrintln("Attempting to save the vibration baseline");
-            vibrationBaselineExists = true;
-            saveBaseline(VIBRATION, vibrationBaseline);
-          }
-          logPrintln("Vibration baseline found and saved");
-        }
-      }
-      TotalVibrationCycles++;
     }
-    temperature_sensor_timer += 5;
-    // send to state 3 when enough temperature data is collected
-    // logPrintln(String(temperatures.size()));
-    // logPrintln(temperature_sensor_timer);
-    if (temperatures.size() >= 120)
+    // send to state 3 after a fixed time, even if no probe could be read, or
+    // early if the compressor stops first
+    if (cycleTicks >= CYCLE_TICKS || transition == TRANSITION_OFF)
     {
       state = 3;
+      if (transition == TRANSITION_OFF)
+      {
+        logPrintln("Compressor stopped during collection");
+      }
       logPrintln("switching to state 3");
-      erase();
+      logPrintln("Vibration blocks dropped this cycle: " + String(acquisitionOverruns()));
     }
-    delay(5); // five millisecond delay
+    delay(1); // let lower priority tasks run, sampling does not depend on it
   }
 
   // ------------------------STATE 3------------------------ //
 
   else if (state == 3)
   {
-    // read temp baseline
-    baselineSlopes = readBaseline(TEMPERATURE);
     // this code might be causing issues with race conditions in HTTP requests
     //  control_lock.lock();
     //  com_control_queue.enqueue(UPDATEMESSAGE);
@@ -349,52 +371,110 @@ void loop()
     //  logPrintln(String(msgStatusId) + " " + lastStatus);
     //  control_lock.unlock();
     //  Analyze temp data
-    if (baselineSlopes.size() >= 100) // TODO change back 100
+    // a cycle with too few good readings has no slope and leaves the baseline alone
+    bool haveSlope = cycleSlope.count >= 3;
+    float slope = haveSlope ? cycleSlope.slope() : 0.0f;
+    tempZScore = 0;
+    if (haveSlope)
+    {
+      logPrintln("slope for last cycle: " + String(slope, 4) + " residual std: " + String(sqrt(cycleSlope.residualVariance()), 3));
+    }
+    else
     {
-      tempZScore = tempAnalysis(baselineSlopes, temperatures);
+      logPrintln("Only " + String(cycleSlope.count) + " temperature readings this cycle, no slope");
     }
-    // Make and store temp baseline
-    if (baselineSlopes.size() < 800)
+    if (haveSlope && temperatureBaselineExists)
     {
-      logPrintln("tempClean for last cycle: " + String(tempClean(temperatures)));
-      baselineSlopes.push_back(tempClean(temperatures));
-      // print the baseline
-      logPrintln("baseline vector: ");
-      for (int i = 0; i < baselineSlopes.size(); i++)
+      tempZScore = tempAnalysis(slopeBaseline, slope);
+      if (slope < slopeBaseline.min || slope > slopeBaseline.max)
       {
-        logPrint(String(baselineSlopes[i]) + ", ");
+        logPrintln("slope outside baseline range " + String(slopeBaseline.min, 4) + " to " + String(slopeBaseline.max, 4));
       }
-      // store the baseline
-      saveBaseline(TEMPERATURE, baselineSlopes);
     }
-    else if (baselineSlopes.size() == 800)
+    // fold the slope into the temp baseline, one small record instead of the whole list
+    if (haveSlope && slopeBaseline.stats.count < TEMP_BASELINE_CYCLES)
     {
-      saveBaseline(TEMPERATURE, baselineSlopes);
+      slopeBaseline.add(slope);
+      storeBinary(TEMP_BASELINE_PATH, &slopeBaseline, sizeof(slopeBaseline));
+      temperatureBaselineExists = slopeBaseline.stats.count >= TEMP_BASELINE_MIN_CYCLES;
+      logPrintln("baseline slope mean: " + String(slopeBaseline.stats.mean[0], 4) + " std: " + String(sqrt(slopeBaseline.stats.variance(0)), 4) + " cycles: " + String(slopeBaseline.stats.count));
     }
 
-    // vibration analysis
-    cycleSTD = cycleSTD / numVibrationCyclesInSTDCalculation;
+    // vibration analysis, one averaged spectrum per cycle reduced to its features
+    if (welch.segments() > 0)
+    {
+      welch.average(cyclePsd);
+      extractFeatures(cyclePsd, cycleFeatures);
+      storeData(cycleFeatures, FEATURE_COUNT, TotalVibrationCycles);
+      storeSpectrum(cyclePsd, TotalVibrationCycles);
+      logPrintln("Vibration features saved as record " + String(TotalVibrationCycles));
+      if (spectrumBaseline.count < VIBRATION_BASELINE_CYCLES)
+      {
+        // spectra stay coded bin to bin until the reference is complete
+        spectrumBaseline.add(cyclePsd, SPECTRUM_LOG_STEP);
+        storeBinary(SPECTRUM_BASELINE_PATH, &spectrumBaseline, sizeof(spectrumBaseline));
+        if (spectrumBaseline.count >= VIBRATION_BASELINE_CYCLES)
+        {
+          spectrumBaseline.codes(spectrumCodes);
+          setSpectrumReference(spectrumCodes);
+        }
+      }
+      if (vibrationBaselineExists)
+      {
+        // compare current vibration to baseline, feature by feature
+        scoreFeatures(cycleFeatures, vibrationStats, vibrationScore);
+        cycleSTD = vibrationScore.score;
+        vibrationDetail = "Vibration: ";
+        for (int i = 0; i < SCORE_TOP_K; i++)
+        {
+          char name[24];
+          describeFeature(vibrationScore.top[i], name, sizeof(name));
+          vibrationDetail += String(name) + " z=" + String(vibrationScore.topZ[i], 1) + (i + 1 < SCORE_TOP_K ? ", " : "");
+        }
+        logPrintln(vibrationDetail);
+      }
+      else
+      {
+        // fold this cycle into the baseline statistics and checkpoint them
+        vibrationStats.add(cycleFeatures);
+        storeBinary(VIBRATION_STATS_PATH, &vibrationStats, sizeof(vibrationStats));
+        if (vibrationStats.count >= VIBRATION_BASELINE_CYCLES)
+        {
+          vibrationBaselineExists = true;
+          logPrintln("Vibration baseline complete, std dev: " + String(sqrt(vibrationStats.totalVariance())));
+        }
+      }
+      TotalVibrationCycles++;
+    }
+    welch.reset();
+    tones.reset();
 
     // Save the temp
-    writeData(TEMPERATURE, temperatures, cycleNum);
-    logPrintln("Temperature data saved as file " + String(cycleNum));
-    cycleNum++;
-    temperatures.clear();
-    File temporaryFile = SD.open("/cyclenumbers.csv", FILE_WRITE);
-    temporaryFile.println(cycleNum);
-    temporaryFile.close();
+    if (temperatures.count() > 0)
+    {
+      storeSeries(TEMPERATURE, temperatures, cycleNum);
+      logPrintln("Temperature data saved as record " + String(cycleNum));
+      cycleNum++;
+    }
+    temperatures.reset();
+    cycleSlope.reset();
+    StorageStats storage = storageStats();
+    logPrintln("Storage queue " + String(storage.inUse) + "/" + String(STORAGE_SLOTS) + " (peak " + String(storage.highWater) +
+               "), last flush " + String(storage.lastFlushMs) + " ms, max " + String(storage.maxFlushMs) + " ms, dropped " + String(storage.dropped) +
+               ", stack free " + String(storage.stackFree) + " B");
 
     control_lock.lock();
     // statusCheck(tempZScore, vibrZScore, lastStatus);
     logPrintln("Vibration Z: " + String(cycleSTD) + " Temp Z: " + String(tempZScore));
     vibrationQueue.enqueue(cycleSTD);
     tempQueue.enqueue(tempZScore);
+    detailQueue.enqueue(vibrationDetail);
     com_control_queue.enqueue(STATUSCHECK);
     control_lock.unlock();
 
     delay(500); // This is the one line you can't remove. It eliminates a potential race condition between the main and comms processes.
 
-    // return to rest state
+    // wait for the compressor to stop, unless it already has
     logPrintln("Switching to state 4");
     state = 4;
     // updateMessage(msgStatusId, "Fridge Compressor 1 Status: " + lastStatus + " (inactive)");
@@ -404,12 +484,11 @@ void loop()
     control_lock.unlock();
 
     // Reset vibration cycle statistics variables
-    numVibrationCyclesInSTDCalculation = 0;
     cycleSTD = 0;
+    vibrationDetail = "";
 
     // Mantainence calls
     // TotalVibrationCycles=countFiles(VIBRATION);
-    erase();
     com_control_queue.enqueue(CHECKTELEGRAM);
     control_lock.lock();
     com_control_queue.enqueue(UPDATEMESSAGE);
@@ -420,8 +499,7 @@ void loop()
   // ------------------------STATE 4------------------------ //
   else if (state == 4)
   {
-    temperatureChecking = simpleTempDetect();
-    if (temperatureChecking.size() == 1 && temperatureChecking[0] == -1)
+    if (transition == TRANSITION_OFF || !compressorDetect.running())
     {
       state = 1;
       logPrintln("Switching to state 1");
@@ -430,5 +508,6 @@ void loop()
       control_lock.unlock();
       digitalWrite(LED, LOW);
     }
+    delay(1);
   }
 }
\ No newline at end of file
@@ -0,0 +1,251 @@
+#include <cmath>
+#include <cstring>
+#include "recordFormat.h"
+#include "spectrumCodec.h"
+#include "seriesCodec.h"
+
+namespace
+{
+    // byte-wise CRC-32 table, built at compile time so it sits in flash
+    struct CrcTable
+    {
+        uint32_t t[256];
+
+        constexpr CrcTable() : t()
+        {
+            for (uint32_t i = 0; i < 256; i++)
+            {
+                uint32_t c = i;
+                for (int k = 0; k < 8; k++)
+                {
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                }
+                t[i] = c;
+            }
+        }
+    };
+
+    constexpr CrcTable crcTable{};
+
+    const size_t MAX_VALUES = 0xFFFF;
+}
+
+uint32_t crc32(const void *data, size_t len, uint32_t crc)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++)
+    {
+        crc = crcTable.t[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static size_t valueBytes(uint8_t encoding)
+{
+    return encoding == ENCODING_INT16 ? sizeof(int16_t) : sizeof(float);
+}
+
+size_t recordSize(RecordEncoding encoding, size_t n)
+{
+    return sizeof(RecordHeader) + n * valueBytes(encoding);
+}
+
+size_t encodeRecord(uint8_t *out, size_t cap, RecordType type, RecordEncoding encoding,
+                    const float *values, size_t n, uint32_t timestamp, int32_t cycle, float scale)
+{
+    size_t size = recordSize(encoding, n);
+    if (n > MAX_VALUES || size > cap)
+    {
+        return 0;
+    }
+
+    if (encoding == ENCODING_INT16 && scale <= 0.0f)
+    {
+        float largest = 0.0f;
+        for (size_t i = 0; i < n; i++)
+        {
+            largest = fmaxf(largest, fabsf(values[i]));
+        }
+        scale = largest > 0.0f ? largest / 32767.0f : 1.0f;
+    }
+
+    RecordHeader h;
+    memset(&h, 0, sizeof(h));
+    h.magic = RECORD_MAGIC;
+    h.version = RECORD_VERSION;
+    h.type = (uint8_t)type;
+    h.encoding = (uint8_t)encoding;
+    h.count = (uint16_t)n;
+    h.timestamp = timestamp;
+    h.cycle = cycle;
+    h.scale = encoding == ENCODING_INT16 ? scale : 1.0f;
+    h.payloadBytes = (uint32_t)(n * valueBytes(encoding));
+
+    uint8_t *payload = out + sizeof(RecordHeader);
+    if (encoding == ENCODING_INT16)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            float q = roundf(values[i] / scale);
+            int16_t v = (int16_t)fmaxf(-32768.0f, fminf(32767.0f, q));
+            memcpy(payload + i * sizeof(v), &v, sizeof(v));
+        }
+    }
+    else
+    {
+        memcpy(payload, values, h.payloadBytes);
+    }
+
+    h.crc = crc32(&h, offsetof(RecordHeader, crc));
+    h.crc = crc32(payload, h.payloadBytes, h.crc);
+    memcpy(out, &h, sizeof(h));
+    return size;
+}
+
+size_t encodeSpectrumRecord(uint8_t *out, size_t cap, const float *psd, size_t n, const int16_t *reference,
+                            uint32_t timestamp, int32_t cycle, float step)
+{
+    if (n > MAX_VALUES || cap < sizeof(RecordHeader))
+    {
+        return 0;
+    }
+    uint8_t *payload = out + sizeof(RecordHeader);
+    size_t packed = packSpectrum(psd, n, reference, step, payload, cap - sizeof(RecordHeader));
+    if (packed == 0 && n > 0)
+    {
+        return 0;
+    }
+
+    RecordHeader h;
+    memset(&h, 0, sizeof(h));
+    h.magic = RECORD_MAGIC;
+    h.version = RECORD_VERSION;
+    h.type = RECORD_SPECTRUM;
+    h.encoding = ENCODING_LOG_DELTA;
+    h.count = (uint16_t)n;
+    h.reference = reference ? spectrumReferenceId(reference, n) : 0;
+    h.timestamp = timestamp;
+    h.cycle = cycle;
+    h.scale = step;
+    h.payloadBytes = (uint32_t)packed;
+
+    h.crc = crc32(&h, offsetof(RecordHeader, crc));
+    h.crc = crc32(payload, h.payloadBytes, h.crc);
+    memcpy(out, &h, sizeof(h));
+    return sizeof(h) + packed;
+}
+
+size_t encodeSeriesRecord(uint8_t *out, size_t cap, RecordType type, const uint8_t *series, size_t bytes,
+                          size_t count, uint32_t timestamp, int32_t cycle)
+{
+    size_t size = sizeof(RecordHeader) + bytes;
+    if (count > MAX_VALUES || size > cap)
+    {
+        return 0;
+    }
+
+    RecordHeader h;
+    memset(&h, 0, sizeof(h));
+    h.magic = RECORD_MAGIC;
+    h.version = RECORD_VERSION;
+    h.type = (uint8_t)type;
+    h.encoding = ENCODING_SERIES;
+    h.count = (uint16_t)count;
+    h.timestamp = timestamp;
+    h.cycle = cycle;
+    h.scale = 1.0f;
+    h.payloadBytes = (uint32_t)bytes;
+
+    uint8_t *payload = out + sizeof(RecordHeader);
+    memcpy(payload, series, bytes);
+    h.crc = crc32(&h, offsetof(RecordHeader, crc));
+    h.crc = crc32(payload, h.payloadBytes, h.crc);
+    memcpy(out, &h, sizeof(h));
+    return size;
+}
+
+bool headerValid(const RecordHeader &h)
+{
+    if (h.magic != RECORD_MAGIC || h.version != RECORD_VERSION)
+    {
+        return false;
+    }
+    if (h.encoding == ENCODING_LOG_DELTA)
+    {
+        return h.scale > 0.0f && h.payloadBytes <= spectrumBound(h.count);
+    }
+    if (h.encoding == ENCODING_SERIES)
+    {
+        return h.payloadBytes <= seriesBound(h.count);
+    }
+    return (h.encoding == ENCODING_FLOAT32 || h.encoding == ENCODING_INT16) &&
+           h.payloadBytes == h.count * valueBytes(h.encoding);
+}
+
+bool recordIntact(const uint8_t *in, size_t len)
+{
+    RecordHeader h;
+    if (len < sizeof(RecordHeader))
+    {
+        return false;
+    }
+    memcpy(&h, in, sizeof(h));
+    if (!headerValid(h) || len < sizeof(h) + h.payloadBytes)
+    {
+        return false;
+    }
+    uint32_t crc = crc32(&h, offsetof(RecordHeader, crc));
+    return crc32(in + sizeof(RecordHeader), h.payloadBytes, crc) == h.crc;
+}
+
+bool decodeRecord(const uint8_t *in, size_t len, RecordHeader &h, float *values, size_t maxN,
+                  const int16_t *reference)
+{
+    if (!recordIntact(in, len))
+    {
+        return false;
+    }
+    memcpy(&h, in, sizeof(h));
+    if (h.count > maxN)
+    {
+        return false;
+    }
+    const uint8_t *payload = in + sizeof(RecordHeader);
+
+    if (h.encoding == ENCODING_LOG_DELTA)
+    {
+        if (h.reference != 0 && (!reference || spectrumReferenceId(reference, h.count) != h.reference))
+        {
+            return false;
+        }
+        return unpackSpectrum(payload, h.payloadBytes, h.count, h.reference ? reference : nullptr, h.scale, values);
+    }
+    if (h.encoding == ENCODING_SERIES)
+    {
+        SeriesReader reader(payload, h.payloadBytes, h.count);
+        uint32_t time;
+        for (size_t i = 0; i < h.count; i++)
+        {
+            if (!reader.next(time, values[i]))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    if (h.encoding == ENCODING_INT16)
+    {
+        for (size_t i = 0; i < h.count; i++)
+        {
+            int16_t v;
+            memcpy(&v, payload + i * sizeof(v), sizeof(v));
+            values[i] = v * h.scale;
+        }
+    }
+    else
+    {
+        memcpy(values, payload, h.payloadBytes);
+    }
+    return true;
+}
@@ -0,0 +1,86 @@
+#ifndef RECORDFORMAT_H
+#define RECORDFORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Binary records stored in the append-only segment files on the SD card.
+ *
+ * A record is a fixed header followed by its payload, both little endian as
+ * the ESP32 lays them out, and checked by a CRC-32 over the header and the
+ * payload. Records follow each other directly with nothing between them.
+ *
+ * This file has no Arduino dependencies so records can be decoded on a PC.
+ */
+
+#define RECORD_MAGIC 0x43455243 // "CREC"
+#define RECORD_VERSION 1
+
+enum RecordType
+{
+    RECORD_TEMPERATURE = 1, // one cycle of temperature readings, degrees C when ENCODING_SERIES
+    RECORD_FEATURES = 2,    // one cycle's vibration feature vector
+    RECORD_SPECTRUM = 3     // one cycle's averaged vibration spectrum
+};
+
+enum RecordEncoding
+{
+    ENCODING_FLOAT32 = 0,
+    ENCODING_INT16 = 1,    // value = stored * scale
+    ENCODING_LOG_DELTA = 2, // packed log2 codes, scale is the step, see spectrumCodec.h
+    ENCODING_SERIES = 3     // timestamped values, see seriesCodec.h
+};
+
+struct RecordHeader
+{
+    uint32_t magic;
+    uint8_t version;
+    uint8_t type;     // RecordType
+    uint8_t encoding; // RecordEncoding
+    uint8_t reserved;
+    uint16_t count;   // values in the payload
+    uint16_t reference; // spectrumReferenceId() of an ENCODING_LOG_DELTA reference, 0 for none
+    uint32_t timestamp; // seconds, since the epoch when the clock was set
+    int32_t cycle;
+    float scale;
+    uint32_t payloadBytes;
+    uint32_t crc; // CRC-32 of everything above and the payload
+};
+
+static_assert(sizeof(RecordHeader) == 32, "record header must stay packed");
+
+// CRC-32 (IEEE), continue a running CRC by passing it back in
+uint32_t crc32(const void *data, size_t len, uint32_t crc = 0);
+
+// bytes a record of n values takes
+size_t recordSize(RecordEncoding encoding, size_t n);
+
+// serialise a record into out, returns its size or 0 if it does not fit.
+// scale is the int16 step, 0 picks one from the largest value
+size_t encodeRecord(uint8_t *out, size_t cap, RecordType type, RecordEncoding encoding,
+                    const float *values, size_t n, uint32_t timestamp, int32_t cycle, float scale);
+
+// serialise a spectrum with spectrumCodec.h, coded against reference (n codes)
+// or, when that is nullptr, bin to bin. Returns the size or 0 if it does not fit
+size_t encodeSpectrumRecord(uint8_t *out, size_t cap, const float *psd, size_t n, const int16_t *reference,
+                            uint32_t timestamp, int32_t cycle, float step);
+
+// wrap count samples encoded by a SeriesEncoder. Returns the size or 0 if it does not fit
+size_t encodeSeriesRecord(uint8_t *out, size_t cap, RecordType type, const uint8_t *series, size_t bytes,
+                          size_t count, uint32_t timestamp, int32_t cycle);
+
+// plausible header, before its payload has been read
+bool headerValid(const RecordHeader &h);
+
+// header and payload match their CRC, whether or not the values can be decoded
+bool recordIntact(const uint8_t *in, size_t len);
+
+// check a whole record and convert its payload to floats (dropping a
+// series' timestamps, read those with a SeriesReader), false if it is
+// damaged, has more than maxN values or needs a reference other than the
+// one given (h.count codes, or nullptr)
+bool decodeRecord(const uint8_t *in, size_t len, RecordHeader &h, float *values, size_t maxN,
+                  const int16_t *reference = nullptr);
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef RUNNINGSTATS_H
+#define RUNNINGSTATS_H
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Running mean and variance of N values at once (Welford's algorithm).
+ *
+ * Each add() is O(N) and numerically stable, and the mean and variance are
+ * available at any time without revisiting old samples. The struct is plain
+ * data so it can be written to and read back from the SD card as it is.
+ */
+template <size_t N>
+struct RunningStats
+{
+    uint32_t count;
+    float mean[N];
+    float m2[N]; // sum of squared deviations from the mean
+
+    void reset()
+    {
+        count = 0;
+        for (size_t i = 0; i < N; i++)
+        {
+            mean[i] = 0.0f;
+            m2[i] = 0.0f;
+        }
+    }
+
+    void add(const float *x)
+    {
+        count++;
+        for (size_t i = 0; i < N; i++)
+        {
+            float delta = x[i] - mean[i];
+            mean[i] += delta / count;
+            m2[i] += delta * (x[i] - mean[i]);
+        }
+    }
+
+    // sample variance of value i, 0 until there are two samples
+    float variance(size_t i) const
+    {
+        return count > 1 ? m2[i] / (count - 1) : 0.0f;
+    }
+
+    // sum of all variances, the expected squared distance of a sample from the mean
+    float totalVariance() const
+    {
+        float total = 0.0f;
+        for (size_t i = 0; i < N; i++)
+        {
+            total += variance(i);
+        }
+        return total;
+    }
+};
+
+#endif
@@ -0,0 +1,270 @@
+#include <cstring>
+#include "seriesCodec.h"
+
+namespace
+{
+    // delta of delta classes: prefix, prefix bits, value bits
+    struct TimeClass
+    {
+        uint32_t prefix;
+        int prefixBits;
+        int valueBits;
+    };
+
+    const TimeClass TIME_CLASSES[] = {
+        {0x1, 2, 7},  // 10 then -64..63
+        {0x3, 3, 9},  // 110 then -256..255
+        {0x7, 4, 12}, // 1110 then -2048..2047
+        {0xF, 4, 32}  // 1111 then anything
+    };
+
+    inline uint32_t floatBits(float v)
+    {
+        uint32_t u;
+        memcpy(&u, &v, sizeof(u));
+        return u;
+    }
+
+    inline float bitsFloat(uint32_t u)
+    {
+        float v;
+        memcpy(&v, &u, sizeof(v));
+        return v;
+    }
+
+    inline int leadingZeros(uint32_t u)
+    {
+        int n = 0;
+        for (uint32_t mask = 0x80000000u; mask && !(u & mask); mask >>= 1)
+        {
+            n++;
+        }
+        return n;
+    }
+
+    inline int trailingZeros(uint32_t u)
+    {
+        int n = 0;
+        for (uint32_t mask = 1; mask && !(u & mask); mask <<= 1)
+        {
+            n++;
+        }
+        return n;
+    }
+
+    inline uint32_t lowMask(int width)
+    {
+        return width >= 32 ? 0xFFFFFFFFu : (1u << width) - 1;
+    }
+}
+
+size_t seriesBound(size_t n)
+{
+    // first sample 64 bits, then at most 4 + 32 for the time and 2 + 10 + 32 for the value
+    return n == 0 ? 0 : 8 + ((n - 1) * 80 + 7) / 8;
+}
+
+SeriesEncoder::SeriesEncoder()
+{
+    reset();
+}
+
+void SeriesEncoder::reset()
+{
+    bits = {buf, sizeof(buf), 0};
+    n = 0;
+    lastTime = 0;
+    lastDelta = 0;
+    lastBits = 0;
+    leading = 32;
+    trailing = 0;
+}
+
+bool SeriesEncoder::add(uint32_t time, float value)
+{
+    BitWriter saved = bits;
+    uint32_t u = floatBits(value);
+    bool ok;
+    int32_t delta = (int32_t)(time - lastTime);
+    int newLeading = leading;
+    int newTrailing = trailing;
+    if (n == 0)
+    {
+        ok = bits.put(time, 32) && bits.put(u, 32);
+        delta = 0;
+    }
+    else
+    {
+        // timestamp as the change of the interval
+        int32_t dod = delta - lastDelta;
+        if (dod == 0)
+        {
+            ok = bits.put(0, 1);
+        }
+        else
+        {
+            const TimeClass *c = &TIME_CLASSES[3];
+            for (const TimeClass &t : TIME_CLASSES)
+            {
+                int32_t half = t.valueBits < 32 ? 1 << (t.valueBits - 1) : 0;
+                if (t.valueBits == 32 || (dod >= -half && dod < half))
+                {
+                    c = &t;
+                    break;
+                }
+            }
+            ok = bits.put(c->prefix, c->prefixBits) && bits.put((uint32_t)dod & lowMask(c->valueBits), c->valueBits);
+        }
+
+        // value as the XOR with the last one
+        uint32_t x = u ^ lastBits;
+        if (x == 0)
+        {
+            ok = ok && bits.put(0, 1);
+        }
+        else
+        {
+            int lz = leadingZeros(x);
+            int tz = trailingZeros(x);
+            if (lz > 31)
+            {
+                lz = 31;
+            }
+            if (leading < 32 && lz >= leading && tz >= trailing)
+            {
+                // fits the previous window: 1, 0, then its bits
+                ok = ok && bits.put(0x1, 2) && bits.put(x >> trailing, 32 - leading - trailing);
+            }
+            else
+            {
+                // 1, 1, 5 bits leading zeros, 5 bits length - 1, then the bits
+                int length = 32 - lz - tz;
+                ok = ok && bits.put(0x3, 2) && bits.put(lz, 5) && bits.put(length - 1, 5) && bits.put(x >> tz, length);
+                newLeading = lz;
+                newTrailing = tz;
+            }
+        }
+    }
+    if (!ok)
+    {
+        bits = saved;
+        return false;
+    }
+    n++;
+    lastTime = time;
+    lastDelta = delta;
+    lastBits = u;
+    leading = newLeading;
+    trailing = newTrailing;
+    return true;
+}
+
+size_t SeriesEncoder::count() const
+{
+    return n;
+}
+
+size_t SeriesEncoder::bytes() const
+{
+    return bits.bytes();
+}
+
+const uint8_t *SeriesEncoder::data() const
+{
+    return buf;
+}
+
+SeriesReader::SeriesReader(const uint8_t *data, size_t len, size_t count)
+    : bits{data, len, 0}, remaining(count), n(0), lastTime(0), lastDelta(0), lastBits(0), leading(32), trailing(0)
+{
+}
+
+bool SeriesReader::next(uint32_t &time, float &value)
+{
+    if (remaining == 0)
+    {
+        return false;
+    }
+    uint32_t v;
+    if (n == 0)
+    {
+        if (!bits.get(32, lastTime) || !bits.get(32, lastBits))
+        {
+            return false;
+        }
+    }
+    else
+    {
+        if (!bits.get(1, v))
+        {
+            return false;
+        }
+        int32_t dod = 0;
+        if (v)
+        {
+            // count further 1 bits of the prefix, up to three in all
+            int ones = 1;
+            while (ones < 4)
+            {
+                if (!bits.get(1, v))
+                {
+                    return false;
+                }
+                if (!v)
+                {
+                    break;
+                }
+                ones++;
+            }
+            const TimeClass &c = TIME_CLASSES[ones - 1];
+            if (!bits.get(c.valueBits, v))
+            {
+                return false;
+            }
+            // sign extend
+            dod = c.valueBits < 32 && (v >> (c.valueBits - 1)) ? (int32_t)(v | ~lowMask(c.valueBits)) : (int32_t)v;
+        }
+        lastDelta += dod;
+        lastTime += lastDelta;
+
+        if (!bits.get(1, v))
+        {
+            return false;
+        }
+        if (v)
+        {
+            if (!bits.get(1, v))
+            {
+                return false;
+            }
+            if (v)
+            {
+                uint32_t lz, length;
+                if (!bits.get(5, lz) || !bits.get(5, length))
+                {
+                    return false;
+                }
+                leading = (int)lz;
+                trailing = 32 - leading - (int)(length + 1);
+                if (trailing < 0)
+                {
+                    return false;
+                }
+            }
+            else if (leading >= 32)
+            {
+                return false;
+            }
+            if (!bits.get(32 - leading - trailing, v))
+            {
+                return false;
+            }
+            lastBits ^= v << trailing;
+        }
+    }
+    remaining--;
+    n++;
+    time = lastTime;
+    value = bitsFloat(lastBits);
+    return true;
+}
@@ -0,0 +1,76 @@
+#ifndef SERIESCODEC_H
+#define SERIESCODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include "bitStream.h"
+
+/*
+ * Lossless compression of a slowly changing (time, value) series, the scheme
+ * of the Gorilla time series database.
+ *
+ * The first sample is stored as it is. After that each timestamp is stored as
+ * the change in the interval since the last one, which is a single 0 bit for a
+ * steady sampling rate, and each value as the XOR of its float bits with the
+ * previous value's. An unchanged value is a single 0 bit; a small change only
+ * flips a few low mantissa bits, which are stored with their position reused
+ * from the previous value whenever they fit in the same window.
+ *
+ * This works best when the values sit on a binary grid, e.g. temperatures in
+ * the sensor's own 1/16 degree steps rather than converted units.
+ *
+ * This file has no Arduino dependencies so series can be decoded on a PC.
+ */
+
+#define SERIES_MAX_BYTES 2048 // encoded size of one series
+
+// largest encoded size of n samples
+size_t seriesBound(size_t n);
+
+// appends samples to a fixed buffer as they arrive
+class SeriesEncoder
+{
+public:
+    SeriesEncoder();
+
+    void reset();
+
+    // false, and nothing added, once the buffer is full
+    bool add(uint32_t time, float value);
+
+    size_t count() const;
+    size_t bytes() const;
+    const uint8_t *data() const;
+
+private:
+    uint8_t buf[SERIES_MAX_BYTES];
+    BitWriter bits;
+    size_t n;
+    uint32_t lastTime;
+    int32_t lastDelta;
+    uint32_t lastBits;
+    int leading; // window of the last stored XOR
+    int trailing;
+};
+
+// walks an encoded series one sample at a time
+class SeriesReader
+{
+public:
+    SeriesReader(const uint8_t *data, size_t len, size_t count);
+
+    // false at the end of the series or if it is malformed
+    bool next(uint32_t &time, float &value);
+
+private:
+    BitReader bits;
+    size_t remaining;
+    size_t n;
+    uint32_t lastTime;
+    int32_t lastDelta;
+    uint32_t lastBits;
+    int leading;
+    int trailing;
+};
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef SLOPEACCUMULATOR_H
+#define SLOPEACCUMULATOR_H
+
+#include <cstdint>
+
+/*
+ * Streaming least-squares line fit of y against its sample index.
+ *
+ * Each add() updates the means and co-moments in O(1), the same way
+ * RunningStats does for a single value, so slope, intercept and residual
+ * variance can be read at any point of a cycle without keeping the samples.
+ * The slope is in units per sample, like the first-5/last-5 slope it replaces.
+ */
+struct SlopeAccumulator
+{
+    uint32_t count;
+    float meanX;
+    float meanY;
+    float sxx; // sum of squared x deviations
+    float sxy; // sum of x*y co-deviations
+    float syy; // sum of squared y deviations
+
+    void reset()
+    {
+        count = 0;
+        meanX = 0.0f;
+        meanY = 0.0f;
+        sxx = 0.0f;
+        sxy = 0.0f;
+        syy = 0.0f;
+    }
+
+    void add(float y)
+    {
+        add((float)count, y);
+    }
+
+    // at an explicit sample index, so a skipped sample leaves its gap
+    void add(float x, float y)
+    {
+        count++;
+        float dx = x - meanX;
+        float dy = y - meanY;
+        meanX += dx / count;
+        meanY += dy / count;
+        sxx += dx * (x - meanX);
+        sxy += dx * (y - meanY);
+        syy += dy * (y - meanY);
+    }
+
+    // 0 until there are two samples
+    float slope() const
+    {
+        return sxx > 0.0f ? sxy / sxx : 0.0f;
+    }
+
+    // fitted value at the first sample
+    float intercept() const
+    {
+        return meanY - slope() * meanX;
+    }
+
+    // variance of the samples around the fitted line, 0 until there are three
+    float residualVariance() const
+    {
+        if (count < 3 || sxx <= 0.0f)
+        {
+            return 0.0f;
+        }
+        float sse = syy - sxy * sxy / sxx;
+        return sse > 0.0f ? sse / (count - 2) : 0.0f;
+    }
+};
+
+#endif
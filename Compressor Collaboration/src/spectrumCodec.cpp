@@ -0,0 +1,121 @@
+#include <cmath>
+#include <cstring>
+#include "spectrumCodec.h"
+#include "recordFormat.h"
+#include "bitStream.h"
+
+namespace
+{
+    // codes stay within 15 bits so every residual fits in 16
+    const int CODE_LIMIT = 16383;
+    const int MAX_WIDTH = 16;
+
+    inline uint32_t zigzag(int32_t v)
+    {
+        return v >= 0 ? (uint32_t)v << 1 : ((uint32_t)(-v) << 1) - 1;
+    }
+
+    inline int32_t unzigzag(uint32_t u)
+    {
+        return (u & 1) ? -(int32_t)((u + 1) >> 1) : (int32_t)(u >> 1);
+    }
+
+    inline int bitWidth(uint32_t u)
+    {
+        int w = 0;
+        while (u)
+        {
+            w++;
+            u >>= 1;
+        }
+        return w;
+    }
+}
+
+int16_t spectrumCode(float x, float step)
+{
+    float c = roundf(log2f(fmaxf(x, SPECTRUM_FLOOR)) / step);
+    return (int16_t)fmaxf(-CODE_LIMIT, fminf(CODE_LIMIT, c));
+}
+
+float spectrumValue(int16_t code, float step)
+{
+    return exp2f(code * step);
+}
+
+size_t spectrumBound(size_t n)
+{
+    size_t blocks = (n + SPECTRUM_BLOCK - 1) / SPECTRUM_BLOCK;
+    return blocks + (n * MAX_WIDTH + 7) / 8;
+}
+
+size_t packSpectrum(const float *x, size_t n, const int16_t *reference, float step, uint8_t *out, size_t cap)
+{
+    BitWriter w = {out, cap, 0};
+    uint32_t residual[SPECTRUM_BLOCK];
+    int16_t last = 0;
+    for (size_t start = 0; start < n; start += SPECTRUM_BLOCK)
+    {
+        size_t count = n - start < SPECTRUM_BLOCK ? n - start : SPECTRUM_BLOCK;
+        uint32_t all = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            int16_t code = spectrumCode(x[start + i], step);
+            int16_t predicted = reference ? reference[start + i] : last;
+            residual[i] = zigzag((int32_t)code - predicted);
+            all |= residual[i];
+            last = code;
+        }
+        int width = bitWidth(all);
+        if (!w.put(width, 8))
+        {
+            return 0;
+        }
+        for (size_t i = 0; i < count; i++)
+        {
+            if (!w.put(residual[i], width))
+            {
+                return 0;
+            }
+        }
+    }
+    return w.bytes();
+}
+
+bool unpackSpectrum(const uint8_t *in, size_t len, size_t n, const int16_t *reference, float step, float *x)
+{
+    BitReader r = {in, len, 0};
+    int32_t last = 0;
+    for (size_t start = 0; start < n; start += SPECTRUM_BLOCK)
+    {
+        size_t count = n - start < SPECTRUM_BLOCK ? n - start : SPECTRUM_BLOCK;
+        uint32_t width;
+        if (!r.get(8, width) || width > MAX_WIDTH)
+        {
+            return false;
+        }
+        for (size_t i = 0; i < count; i++)
+        {
+            uint32_t u;
+            if (!r.get((int)width, u))
+            {
+                return false;
+            }
+            int32_t predicted = reference ? reference[start + i] : last;
+            int32_t code = predicted + unzigzag(u);
+            if (code < -CODE_LIMIT || code > CODE_LIMIT)
+            {
+                return false;
+            }
+            x[start + i] = spectrumValue((int16_t)code, step);
+            last = code;
+        }
+    }
+    return true;
+}
+
+uint16_t spectrumReferenceId(const int16_t *reference, size_t n)
+{
+    uint16_t id = (uint16_t)crc32(reference, n * sizeof(int16_t));
+    return id ? id : 1;
+}
@@ -0,0 +1,89 @@
+#ifndef SPECTRUMCODEC_H
+#define SPECTRUMCODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+
+/*
+ * Lossy codec for power spectra.
+ *
+ * Every bin is quantized to an integer code on a log2 scale,
+ *
+ *   code = round(log2(max(x, SPECTRUM_FLOOR)) / step),  x' = 2^(code * step)
+ *
+ * so the reconstruction error is relative rather than absolute: for every bin
+ * at or above SPECTRUM_FLOOR
+ *
+ *   2^(-step/2) <= x' / x <= 2^(step/2)
+ *
+ * which with the default step of 1/8 is within 4.4 % (0.19 dB), and bins
+ * below the floor come back as about SPECTRUM_FLOOR. The codes are then
+ * replaced by their difference from a reference spectrum's codes, or from the
+ * previous bin when there is no reference, and the residuals are bit packed
+ * in blocks of SPECTRUM_BLOCK that share the smallest width that fits them.
+ * Only the quantization loses information; the packing is exact.
+ *
+ * This file has no Arduino dependencies so spectra can be decoded on a PC.
+ */
+
+#define SPECTRUM_LOG_STEP 0.125f // log2 units per code
+#define SPECTRUM_FLOOR 1e-9f     // smallest value kept, counts^2/Hz
+#define SPECTRUM_BLOCK 32        // residuals sharing one bit width
+
+// quantize one value, and the value a code stands for
+int16_t spectrumCode(float x, float step);
+float spectrumValue(int16_t code, float step);
+
+// largest packed size of n bins, whatever the spectrum
+size_t spectrumBound(size_t n);
+
+// pack n bins into out, returns the bytes used or 0 if cap is too small.
+// reference holds n codes, or is nullptr to code each bin against the last
+size_t packSpectrum(const float *x, size_t n, const int16_t *reference, float step, uint8_t *out, size_t cap);
+
+// inverse of packSpectrum with the same n, reference and step, false if the
+// data is truncated or malformed
+bool unpackSpectrum(const uint8_t *in, size_t len, size_t n, const int16_t *reference, float step, float *x);
+
+// short fingerprint of a reference, never 0, stored with the spectra coded against it
+uint16_t spectrumReferenceId(const int16_t *reference, size_t n);
+
+/*
+ * Mean log spectrum of a set of cycles, the reference later spectra are coded
+ * against. Plain data so it can be checkpointed to the card as it is.
+ */
+template <size_t N>
+struct SpectrumReference
+{
+    uint32_t count;
+    float meanCode[N];
+
+    void reset()
+    {
+        count = 0;
+        for (size_t i = 0; i < N; i++)
+        {
+            meanCode[i] = 0.0f;
+        }
+    }
+
+    void add(const float *x, float step)
+    {
+        count++;
+        for (size_t i = 0; i < N; i++)
+        {
+            meanCode[i] += (spectrumCode(x[i], step) - meanCode[i]) / count;
+        }
+    }
+
+    void codes(int16_t *out) const
+    {
+        for (size_t i = 0; i < N; i++)
+        {
+            out[i] = (int16_t)lroundf(meanCode[i]);
+        }
+    }
+};
+
+#endif
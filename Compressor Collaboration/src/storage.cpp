@@ -0,0 +1,231 @@
+#include "storage.h"
+
+enum JobKind
+{
+    JOB_RECORD,
+    JOB_BINARY
+};
+
+struct StorageJob
+{
+    JobKind kind;
+    Mode mode;
+    char path[48];
+    size_t len;
+    size_t cap;
+    uint8_t *data;
+};
+
+// slots below STORAGE_SMALL_SLOTS use the small buffers, the rest the large ones
+static StorageJob slots[STORAGE_SLOTS];
+static uint8_t smallBuffers[STORAGE_SMALL_SLOTS][STORAGE_SMALL_BYTES];
+static uint8_t largeBuffers[STORAGE_LARGE_SLOTS][STORAGE_SLOT_BYTES];
+static QueueHandle_t freeSmall = NULL; // indices of empty buffers
+static QueueHandle_t freeLarge = NULL;
+static QueueHandle_t pending = NULL;   // indices of filled buffers, oldest first
+static TaskHandle_t storageHandle;
+
+static portMUX_TYPE statsLock = portMUX_INITIALIZER_UNLOCKED;
+static StorageStats stats = {0, 0, 0, 0, 0, 0, 0, 0};
+
+static void releaseSlot(uint8_t index)
+{
+    xQueueSend(index < STORAGE_SMALL_SLOTS ? freeSmall : freeLarge, &index, 0);
+}
+
+static void storageTask(void *args)
+{
+    uint8_t index;
+    bool unflushed[2] = {false, false}; // per Mode
+    while (true)
+    {
+        if (xQueueReceive(pending, &index, portMAX_DELAY) != pdTRUE)
+        {
+            continue;
+        }
+        StorageJob &job = slots[index];
+        unsigned long start = millis();
+        bool ok = false;
+        if (job.kind == JOB_RECORD)
+        {
+            ok = appendRecord(job.mode, job.data, job.len);
+            unflushed[job.mode] = true;
+        }
+        else
+        {
+            ok = saveBinary(job.path, job.data, job.len);
+        }
+        // records are written once the queue runs dry, so a cycle end's
+        // records go to the card together rather than one write each
+        if (uxQueueMessagesWaiting(pending) == 0)
+        {
+            for (int mode = 0; mode < 2; mode++)
+            {
+                if (unflushed[mode])
+                {
+                    ok = flushData((Mode)mode) && ok;
+                    unflushed[mode] = false;
+                }
+            }
+        }
+        unsigned long took = millis() - start;
+
+        portENTER_CRITICAL(&statsLock);
+        stats.jobs++;
+        stats.failed += ok ? 0 : 1;
+        stats.lastFlushMs = took;
+        if (took > stats.maxFlushMs)
+        {
+            stats.maxFlushMs = took;
+        }
+        stats.inUse--;
+        portEXIT_CRITICAL(&statsLock);
+        releaseSlot(index);
+    }
+}
+
+bool storageBegin()
+{
+    freeSmall = xQueueCreate(STORAGE_SMALL_SLOTS, sizeof(uint8_t));
+    freeLarge = xQueueCreate(STORAGE_LARGE_SLOTS, sizeof(uint8_t));
+    pending = xQueueCreate(STORAGE_SLOTS, sizeof(uint8_t));
+    if (!freeSmall || !freeLarge || !pending)
+    {
+        return false;
+    }
+    for (uint8_t i = 0; i < STORAGE_SLOTS; i++)
+    {
+        bool small = i < STORAGE_SMALL_SLOTS;
+        slots[i].data = small ? smallBuffers[i] : largeBuffers[i - STORAGE_SMALL_SLOTS];
+        slots[i].cap = small ? STORAGE_SMALL_BYTES : STORAGE_SLOT_BYTES;
+        releaseSlot(i);
+    }
+    // on core 0 with the comms task, above it so records are not held up by HTTP requests
+    return xTaskCreatePinnedToCore(storageTask, "STORAGE", STORAGE_STACK, NULL, 1, &storageHandle, 0) == pdPASS;
+}
+
+// an empty buffer of at least need bytes, nullptr (and counted) if all that
+// fit are queued
+static StorageJob *takeSlot(size_t need, uint8_t &index)
+{
+    bool small = need <= STORAGE_SMALL_BYTES && freeSmall && xQueueReceive(freeSmall, &index, 0) == pdTRUE;
+    if (!small && (need > STORAGE_SLOT_BYTES || !freeLarge || xQueueReceive(freeLarge, &index, 0) != pdTRUE))
+    {
+        portENTER_CRITICAL(&statsLock);
+        stats.dropped++;
+        portEXIT_CRITICAL(&statsLock);
+        return nullptr;
+    }
+    portENTER_CRITICAL(&statsLock);
+    stats.inUse++;
+    if (stats.inUse > stats.highWater)
+    {
+        stats.highWater = stats.inUse;
+    }
+    portEXIT_CRITICAL(&statsLock);
+    return &slots[index];
+}
+
+static void giveSlot(uint8_t index)
+{
+    // pending has room for every buffer, so this never waits
+    xQueueSend(pending, &index, 0);
+}
+
+static void returnSlot(uint8_t index)
+{
+    portENTER_CRITICAL(&statsLock);
+    stats.inUse--;
+    stats.dropped++;
+    portEXIT_CRITICAL(&statsLock);
+    releaseSlot(index);
+}
+
+bool storeData(const float *values, size_t n, int cycle_num)
+{
+    uint8_t index;
+    StorageJob *job = takeSlot(sizeof(RecordHeader) + n * sizeof(float), index);
+    if (!job)
+    {
+        return false;
+    }
+    job->kind = JOB_RECORD;
+    job->mode = VIBRATION;
+    job->len = encodeData(values, n, cycle_num, job->data, job->cap);
+    if (job->len == 0)
+    {
+        returnSlot(index);
+        return false;
+    }
+    giveSlot(index);
+    return true;
+}
+
+bool storeSeries(Mode mode, const SeriesEncoder &series, int cycle_num)
+{
+    uint8_t index;
+    StorageJob *job = takeSlot(sizeof(RecordHeader) + series.bytes(), index);
+    if (!job)
+    {
+        return false;
+    }
+    job->kind = JOB_RECORD;
+    job->mode = mode;
+    job->len = encodeSeries(mode, series, cycle_num, job->data, job->cap);
+    if (job->len == 0)
+    {
+        returnSlot(index);
+        return false;
+    }
+    giveSlot(index);
+    return true;
+}
+
+bool storeSpectrum(const float *psd, int cycle_num)
+{
+    uint8_t index;
+    StorageJob *job = takeSlot(sizeof(RecordHeader) + spectrumBound(SPECTRUM_BINS), index);
+    if (!job)
+    {
+        return false;
+    }
+    job->kind = JOB_RECORD;
+    job->mode = VIBRATION;
+    job->len = encodeSpectrum(psd, cycle_num, job->data, job->cap);
+    if (job->len == 0)
+    {
+        returnSlot(index);
+        return false;
+    }
+    giveSlot(index);
+    return true;
+}
+
+bool storeBinary(const char *path, const void *data, size_t len)
+{
+    if (len > STORAGE_SLOT_BYTES || strlen(path) >= sizeof(StorageJob::path))
+    {
+        return false;
+    }
+    uint8_t index;
+    StorageJob *job = takeSlot(len, index);
+    if (!job)
+    {
+        return false;
+    }
+    job->kind = JOB_BINARY;
+    strcpy(job->path, path);
+    memcpy(job->data, data, len);
+    job->len = len;
+    giveSlot(index);
+    return true;
+}
+
+StorageStats storageStats()
+{
+    portENTER_CRITICAL(&statsLock);
+    StorageStats copy = stats;
+    portEXIT_CRITICAL(&statsLock);
+    copy.stackFree = storageHandle ? uxTaskGetStackHighWaterMark(storageHandle) : 0;
+    return copy;
+}
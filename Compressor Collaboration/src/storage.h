@@ -0,0 +1,58 @@
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include <Arduino.h>
+#include "dataStorage.h"
+
+/*
+ * Write-behind storage.
+ *
+ * loop() serialises what it wants stored into one of STORAGE_SLOTS fixed
+ * buffers and hands it to a storage task through a bounded FreeRTOS queue,
+ * so the acquisition and analysis path never waits on the SD card. The task
+ * collects the records it is given and writes them in one sequential
+ * transfer once the queue is empty, while loop() fills the next buffer.
+ * If every buffer is still queued the job is dropped and counted rather
+ * than blocking.
+ */
+
+// buffers in two sizes, together at least as many as one cycle end queues.
+// Features, series and small checkpoints take a small one when it is free,
+// spectra and the spectrum reference always need a large one
+#define STORAGE_SMALL_SLOTS 5
+#define STORAGE_SMALL_BYTES 512
+#define STORAGE_LARGE_SLOTS 3
+#define STORAGE_SLOT_BYTES RECORD_MAX_BYTES // largest job
+#define STORAGE_SLOTS (STORAGE_SMALL_SLOTS + STORAGE_LARGE_SLOTS)
+#define STORAGE_STACK 8192 // bytes, rebuilding an index nests several SD calls
+
+struct StorageStats
+{
+    uint32_t jobs;          // written so far
+    uint32_t dropped;       // refused because every buffer was in use
+    uint32_t failed;        // the card reported an error
+    uint32_t inUse;         // buffers queued or being written right now
+    uint32_t highWater;     // most buffers in use at once
+    uint32_t lastFlushMs;   // time the last job took
+    uint32_t maxFlushMs;
+    uint32_t stackFree;     // least stack the task has had left, bytes
+};
+
+// create the queues and start the task, false if FreeRTOS ran out of memory
+bool storageBegin();
+
+// queue one cycle's vibration features, as encodeData() codes them
+bool storeData(const float *values, size_t n, int cycle_num);
+
+// queue one cycle's timestamped readings, as encodeSeries() codes them
+bool storeSeries(Mode mode, const SeriesEncoder &series, int cycle_num);
+
+// queue one cycle's spectrum, as encodeSpectrum() codes it
+bool storeSpectrum(const float *psd, int cycle_num);
+
+// queue a binary checkpoint, as saveBinary() would store it
+bool storeBinary(const char *path, const void *data, size_t len);
+
+StorageStats storageStats();
+
+#endif
@@ -1,43 +1,16 @@
 #include "tempAnalysis.h"
 #include <cmath>
 
-float tempAnalysis(std::vector<float>& slopes, std::vector<float>& newTemp) {
+float tempAnalysis(const SlopeBaseline& baseline, float newSlope) {
   
-  // Calculate mean of first 5 temps in newTemp
-  float newLowMean = 0.0;
-  for (int i = 0; i < 5; i++) {
-    newLowMean += newTemp[i];
+  // Standard deviation of the historical slopes
+  float slopesStdDev = std::sqrt(baseline.stats.variance(0));
+  if (slopesStdDev <= 0.0f) {
+    return 0.0f;
   }
-  newLowMean /= 5;
-  
-  // Calculate mean of last 5 temps in newTemp
-  float newHighMean = 0.0;
-  for (int i = newTemp.size() - 5; i < newTemp.size(); i++) {
-    newHighMean += newTemp[i];
-  }
-  newHighMean /= 5;
-  
-  // Calculate slope for newTemp
-  float newSlope = (newHighMean - newLowMean) / (newTemp.size() - 5);
-  
-  // Calculate mean of slopes
-  float slopesMean = 0.0;
-  for (float slope : slopes) {
-    slopesMean += slope;
-  }
-  slopesMean /= slopes.size();
-  
-  // Calculate standard deviation of slopes
-  float variance = 0.0;
-  for (float slope : slopes) {
-    float diff = slope - slopesMean;
-    variance += diff * diff;
-  }
-  variance /= slopes.size();
-  float slopesStdDev = std::sqrt(variance);
   
   // Calculate z-score
-  float zScore = abs((newSlope - slopesMean) / slopesStdDev);
+  float zScore = std::fabs((newSlope - baseline.stats.mean[0]) / slopesStdDev);
   
   return zScore;
-}
\ No newline at end of file
+}
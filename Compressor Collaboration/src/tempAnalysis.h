@@ -1,19 +1,53 @@
 #ifndef TEMPANALYSIS_H
 #define TEMPANALYSIS_H
 
-#include <vector>
+#include "runningStats.h"
+
+/*
+ * Baseline of per-cycle temperature slopes.
+ *
+ * Running count, mean and M2 plus the extremes seen, updated in O(1) per
+ * cycle. Plain data so it is checkpointed to the card with saveBinary()
+ * instead of keeping every slope.
+ */
+struct SlopeBaseline
+{
+    RunningStats<1> stats;
+    float min;
+    float max;
+
+    void reset()
+    {
+        stats.reset();
+        min = 0.0f;
+        max = 0.0f;
+    }
+
+    void add(float slope)
+    {
+        if (stats.count == 0 || slope < min)
+        {
+            min = slope;
+        }
+        if (stats.count == 0 || slope > max)
+        {
+            max = slope;
+        }
+        stats.add(&slope);
+    }
+};
 
 /**
  * Analyzes temperature data by calculating a z-score for the temperature trend.
  * 
- * This function computes the slope of the new temperature data and compares it
- * to a collection of historical slopes using z-score normalization.
+ * This function compares the slope of the new temperature data to the
+ * baseline of historical slopes using z-score normalization.
  * 
- * @param slopes Vector of historical temperature slopes for comparison
- * @param newTemp Vector of new temperature readings (must have at least 10 elements)
- * @return Z-score indicating how the new temperature slope compares to historical slopes
- *         (positive = steeper increase than average, negative = less steep than average)
+ * @param baseline Statistics of historical temperature slopes for comparison
+ * @param newSlope Least-squares slope of the new cycle, see SlopeAccumulator
+ * @return Z-score indicating how far the new temperature slope is from the
+ *         historical slopes, 0 while the baseline has no spread yet
  */
-float tempAnalysis(std::vector<float>& slopes, std::vector<float>& newTemp);
+float tempAnalysis(const SlopeBaseline& baseline, float newSlope);
 
-#endif
\ No newline at end of file
+#endif
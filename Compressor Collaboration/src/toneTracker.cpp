@@ -0,0 +1,153 @@
+#include <cmath>
+#include "toneTracker.h"
+
+static const float DC_ALPHA = 0.001f; // EMA factor for removing the ADC offset
+static const double TWO_PI = 6.283185307179586476925286766559;
+
+ToneTracker::ToneTracker(float sampleRate, float fundamental, size_t harmonics)
+{
+    count = 0;
+    for (size_t h = 1; h <= harmonics && count < MAX_TONES; h++)
+    {
+        float f = fundamental * h;
+        if (f >= sampleRate / 2)
+        {
+            break;
+        }
+        double w = TWO_PI * f / sampleRate;
+        freq[count] = f;
+        stepRe[count] = (float)cos(w);
+        stepIm[count] = (float)-sin(w);
+        dropRe[count] = (float)cos(w * WINDOW);
+        dropIm[count] = (float)sin(w * WINDOW);
+        count++;
+    }
+    reset();
+}
+
+void ToneTracker::reset()
+{
+    pos = 0;
+    filled = 0;
+    sinceResync = 0;
+    dc = 0.0f;
+    for (size_t i = 0; i < count; i++)
+    {
+        rotRe[i] = 1.0f;
+        rotIm[i] = 0.0f;
+        sumRe[i] = 0.0f;
+        sumIm[i] = 0.0f;
+    }
+}
+
+void ToneTracker::push(float x)
+{
+    if (filled == 0)
+    {
+        dc = x;
+    }
+    dc += DC_ALPHA * (x - dc);
+    float v = x - dc;
+
+    bool full = filled == WINDOW;
+    float old = history[pos];
+    for (size_t i = 0; i < count; i++)
+    {
+        float r = rotRe[i], q = rotIm[i];
+        if (full)
+        {
+            // phasor of the leaving sample is e^{-jw(n-W)} = rot * e^{jwW}
+            sumRe[i] -= old * (r * dropRe[i] - q * dropIm[i]);
+            sumIm[i] -= old * (r * dropIm[i] + q * dropRe[i]);
+        }
+        sumRe[i] += v * r;
+        sumIm[i] += v * q;
+        rotRe[i] = r * stepRe[i] - q * stepIm[i];
+        rotIm[i] = r * stepIm[i] + q * stepRe[i];
+    }
+
+    history[pos] = v;
+    pos = (pos + 1) % WINDOW;
+    if (!full)
+    {
+        filled++;
+    }
+    else if (++sinceResync >= RESYNC_WINDOWS * WINDOW)
+    {
+        resync();
+    }
+}
+
+void ToneTracker::resync()
+{
+    // restart the phase reference at the oldest sample and sum the window again
+    for (size_t i = 0; i < count; i++)
+    {
+        float r = 1.0f, q = 0.0f;
+        float sr = 0.0f, si = 0.0f;
+        for (size_t m = 0; m < WINDOW; m++)
+        {
+            float v = history[(pos + m) % WINDOW];
+            sr += v * r;
+            si += v * q;
+            float nr = r * stepRe[i] - q * stepIm[i];
+            q = r * stepIm[i] + q * stepRe[i];
+            r = nr;
+        }
+        sumRe[i] = sr;
+        sumIm[i] = si;
+        rotRe[i] = r;
+        rotIm[i] = q;
+    }
+    sinceResync = 0;
+}
+
+bool ToneTracker::ready() const
+{
+    return filled == WINDOW;
+}
+
+size_t ToneTracker::tones() const
+{
+    return count;
+}
+
+float ToneTracker::frequency(size_t i) const
+{
+    return freq[i];
+}
+
+float ToneTracker::amplitude(size_t i) const
+{
+    if (filled == 0)
+    {
+        return 0.0f;
+    }
+    return 2.0f * sqrtf(sumRe[i] * sumRe[i] + sumIm[i] * sumIm[i]) / filled;
+}
+
+float ToneTracker::phase(size_t i) const
+{
+    // sum * conj(rot) moves the reference to the next sample, step back by w
+    float re = sumRe[i] * rotRe[i] + sumIm[i] * rotIm[i];
+    float im = sumIm[i] * rotRe[i] - sumRe[i] * rotIm[i];
+    float p = atan2f(im, re) + atan2f(stepIm[i], stepRe[i]);
+    if (p <= -(float)M_PI)
+    {
+        p += (float)TWO_PI;
+    }
+    return p;
+}
+
+size_t ToneTracker::strongest() const
+{
+    size_t best = 0;
+    for (size_t i = 1; i < count; i++)
+    {
+        if (amplitude(i) > amplitude(best))
+        {
+            best = i;
+        }
+    }
+    return best;
+}
@@ -0,0 +1,62 @@
+#ifndef TONETRACKER_H
+#define TONETRACKER_H
+
+#include <cstddef>
+
+#define LINE_FREQUENCY 60.0f // Hz, compressor motors run at the mains frequency
+#define TONE_HARMONICS 4     // fundamental plus three harmonics
+
+/*
+ * Sliding DFT bank tracking the line frequency and its harmonics.
+ *
+ * Each tone keeps the DFT of the last WINDOW samples at exactly its own
+ * frequency. A new sample adds its term and removes the term of the sample
+ * leaving the window, so an update costs O(tones) and the amplitude and phase
+ * can be read after any sample without running a full transform.
+ *
+ * The sums are rebuilt from the history buffer every RESYNC_WINDOWS windows,
+ * which keeps float round-off from accumulating over a long run.
+ */
+class ToneTracker
+{
+public:
+    static const size_t WINDOW = 512;
+    static const size_t MAX_TONES = 8;
+    static const size_t RESYNC_WINDOWS = 16;
+
+    // tracks fundamental * 1..harmonics, skipping any at or above Nyquist
+    ToneTracker(float sampleRate, float fundamental, size_t harmonics);
+
+    void push(float x);
+    void reset();
+
+    // true once a full window has been seen
+    bool ready() const;
+
+    size_t tones() const;
+    float frequency(size_t i) const;
+    // peak amplitude of the tone in ADC counts
+    float amplitude(size_t i) const;
+    // phase in radians at the latest sample
+    float phase(size_t i) const;
+    // index of the tone with the largest amplitude
+    size_t strongest() const;
+
+private:
+    void resync();
+
+    float history[WINDOW]; // DC removed samples, oldest at pos once full
+    size_t pos;
+    size_t filled;
+    size_t sinceResync;
+    float dc;
+
+    size_t count;
+    float freq[MAX_TONES];
+    float stepRe[MAX_TONES], stepIm[MAX_TONES]; // e^{-jw}
+    float dropRe[MAX_TONES], dropIm[MAX_TONES]; // e^{jwW}, phasor of the sample leaving
+    float rotRe[MAX_TONES], rotIm[MAX_TONES];   // e^{-jwn} for the next sample
+    float sumRe[MAX_TONES], sumIm[MAX_TONES];
+};
+
+#endif
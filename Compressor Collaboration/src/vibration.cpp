@@ -1,145 +1,115 @@
-#include <iostream>
-#include <vector>
-#include <complex>
 #include <cmath>
-#include <Arduino.h>
+#include <cstdio>
 #include "vibration.h"
 
-// FFT courtesy of https://www.w3computing.com/articles/how-to-implement-a-fast-fourier-transform-fft-in-cpp/
-
-bool store_vibration()
+// reduce a SPECTRUM_BINS long PSD to FEATURE_COUNT values, see the Feature enum
+void extractFeatures(const float *psd, float *features)
 {
-    // store the vibration and detect if it is ready for transform
-    if (data.size() == 2048)
+    const float eps = 1e-12f;
+    const float df = VIBRATION_SAMPLE_RATE / FFT_SIZE;
+    const size_t first = 1; // DC only holds what the mean removal left behind
+    const size_t last = SPECTRUM_BINS - 1;
+    const size_t used = last - first + 1;
+
+    float total = 0.0f;
+    float weighted = 0.0f;
+    float logSum = 0.0f;
+    float maxBin = 0.0f;
+    size_t peak = first;
+    for (size_t b = 0; b < FEATURE_BANDS; b++)
     {
-        return true;
+        size_t lo = first + b * used / FEATURE_BANDS;
+        size_t hi = first + (b + 1) * used / FEATURE_BANDS;
+        float energy = 0.0f;
+        for (size_t k = lo; k < hi; k++)
+        {
+            float f = (float)k / last;
+            energy += psd[k];
+            weighted += f * psd[k];
+            logSum += log(psd[k] + eps);
+            if (psd[k] > maxBin)
+            {
+                maxBin = psd[k];
+                peak = k;
+            }
+        }
+        total += energy;
+        features[b] = log10(energy * df + eps);
     }
-    data.push_back({(float)analogRead(PIEZO_PIN), 0.0f});
-    return data.size() == 2048;
-}
 
-void erase()
-{
-    // reset the data vector
-    while (data.size() > 0)
+    float mean = total / used;
+    float centroid = total > 0 ? weighted / total : 0.0f;
+    float m2 = 0.0f, m3 = 0.0f, m4 = 0.0f;
+    for (size_t k = first; k <= last; k++)
     {
-        data.pop_back();
+        float d = (float)k / last - centroid;
+        float p = psd[k] * d * d;
+        m2 += p;
+        m3 += p * d;
+        m4 += p * d * d;
     }
-}
-
-bool detect_activity()
-{
-    // detect compressor activity
-    bool active=false;
-    for (int i = 0; i < 500; i++)
+    if (total > 0)
     {
-        if (analogRead(PIEZO_PIN) > 250)
-        {
-            active=true;
-            break;
-        }
-        delay(1);
+        m2 /= total;
+        m3 /= total;
+        m4 /= total;
     }
-    return active;
+    float spread = sqrt(m2);
+
+    features[FEATURE_RMS] = log10(sqrt(total * df) + eps);
+    features[FEATURE_CENTROID] = centroid;
+    features[FEATURE_SPREAD] = spread;
+    features[FEATURE_SKEWNESS] = m2 > 0 ? m3 / (m2 * spread) : 0.0f;
+    features[FEATURE_KURTOSIS] = m2 > 0 ? m4 / (m2 * m2) : 0.0f;
+    features[FEATURE_FLATNESS] = mean > 0 ? exp(logSum / used) / mean : 0.0f;
+    features[FEATURE_CREST] = log10(maxBin / (mean + eps) + eps);
+    features[FEATURE_PEAK] = (float)peak / last;
 }
 
-void fft(CArray &x)
+// diagonal Mahalanobis distance of a feature vector from the baseline, in one
+// pass that also keeps the SCORE_TOP_K largest contributions
+void scoreFeatures(const float *features, const RunningStats<FEATURE_COUNT> &baseline, AnomalyScore &out)
 {
-    // perform FFT in-place
-    const size_t N = x.size();
-    if (N <= 1)
-        return;
-
-    // Bit-reversed addressing permutation
-    size_t j = 0;
-    for (size_t i = 1; i < N; ++i)
+    const float minVariance = 1e-6f; // a feature that never moved should not divide by zero
+    size_t found = 0;
+    float sum = 0.0f;
+    for (size_t i = 0; i < FEATURE_COUNT; i++)
     {
-        size_t bit = N >> 1;
-        while (j & bit)
-        {
-            j ^= bit;
-            bit >>= 1;
-        }
-        j ^= bit;
+        float var = baseline.variance(i);
+        float z = (features[i] - baseline.mean[i]) / sqrt(var > minVariance ? var : minVariance);
+        sum += z * z;
 
-        if (i < j)
+        // insertion into the short sorted list of largest |z|
+        size_t j = found < SCORE_TOP_K ? found++ : SCORE_TOP_K;
+        while (j > 0 && fabs(z) > fabs(out.topZ[j - 1]))
         {
-            swap(x[i], x[j]);
-        }
-    }
-
-    // Iterative FFT
-    for (size_t len = 2; len <= N; len <<= 1)
-    {
-        double angle = -2 * pi / len;
-        Complex wlen(cos(angle), sin(angle));
-        for (size_t i = 0; i < N; i += len)
-        {
-            Complex w(1);
-            for (size_t j = 0; j < len / 2; ++j)
+            if (j < SCORE_TOP_K)
             {
-                Complex u = x[i + j];
-                Complex v = x[i + j + len / 2] * w;
-                x[i + j] = u + v;
-                x[i + j + len / 2] = u - v;
-                w *= wlen;
+                out.top[j] = out.top[j - 1];
+                out.topZ[j] = out.topZ[j - 1];
             }
+            j--;
+        }
+        if (j < SCORE_TOP_K)
+        {
+            out.top[j] = i;
+            out.topZ[j] = z;
         }
     }
+    out.score = sqrt(sum / FEATURE_COUNT);
 }
 
-// convert complex vector to float vector
-vector<float> magnitude(const CArray transform)
+// short readable name of feature i, e.g. "208-229Hz band" or "kurtosis"
+void describeFeature(size_t i, char *buf, size_t len)
 {
-    // make the transform real
-    vector<float> t;
-    for (int i = 0; i < transform.size(); i++)
+    static const char *names[] = {"RMS", "centroid", "spread", "skewness", "kurtosis", "flatness", "crest", "peak freq"};
+    if (i < FEATURE_BANDS)
     {
-        t.push_back(abs(transform[i]));
-    }
-    return t;
-}
-
-// compare two vectors
-float compare(const vector<float> baseline, const vector<float> current)
-{
-    // Serial.println("Comparing vibrations");
-    // Compare a baseline vector with a new vector
-    if (baseline.size()!=current.size()){
-        Serial.println("Cannot compare vectors of different sizes");
-        return 0;
+        const float nyquist = VIBRATION_SAMPLE_RATE / 2;
+        snprintf(buf, len, "%d-%dHz band", (int)(nyquist * i / FEATURE_BANDS), (int)(nyquist * (i + 1) / FEATURE_BANDS));
     }
-    float diff = 0.0f;
-    for (int i = 0; i < baseline.size(); i++)
+    else
     {
-        diff += pow(baseline[i] - current[i], 2);
+        snprintf(buf, len, "%s", names[i - FEATURE_BANDS]);
     }
-    return diff;
 }
-
-vector<float> vectordifference(const vector<float> a, const vector<float> b){
-    vector<float> temp;
-    for(int i=0;i<2048;i++){
-        temp.push_back(a[i]-b[i]);
-    }
-    return temp;
-}
-
-float vectorsize(const vector<float> a){
-    float temp=0;
-    for(int i=0;i<2048;i++){
-        temp+=a[i]*a[i];
-    }
-    return pow(temp, 0.5f);
-}
-
-bool isOff(){
-    for(int i=0;i<5000;i++){
-        if(analogRead(PIEZO_PIN)>250){
-            return false;
-        }
-        delay(1);
-    }
-    return true;
-}
-
@@ -2,25 +2,43 @@
 #define VIBRATION_H
 
 #include <vector>
-#include <complex>
 #include <cmath>
+#include "runningStats.h"
 
 #define PIEZO_PIN 32
-#define pi 3.141592653589793238462643383279502884197169399
+#define FFT_SIZE 2048 // samples per vibration block
+#define SPECTRUM_BINS (FFT_SIZE / 2 + 1) // bins of a real FFT, DC to Nyquist
+#define VIBRATION_SAMPLE_RATE 1000.0f // Hz, fixed by the I2S clock in acquisition.cpp
 
-using namespace std;
-using Complex = complex<float>;
-using CArray = vector<Complex>;
+// compact description of a spectrum, this is what gets stored and compared
+#define FEATURE_BANDS 24 // equal width bands from DC to Nyquist
+#define FEATURE_COUNT (FEATURE_BANDS + 8)
+enum Feature
+{
+    // 0..FEATURE_BANDS-1 are log10 band energies
+    FEATURE_RMS = FEATURE_BANDS, // log10 of the RMS in ADC counts
+    FEATURE_CENTROID,            // frequencies are fractions of Nyquist
+    FEATURE_SPREAD,
+    FEATURE_SKEWNESS,
+    FEATURE_KURTOSIS,
+    FEATURE_FLATNESS, // geometric over arithmetic mean, 0 for a tone, 1 for white noise
+    FEATURE_CREST,    // log10 of the largest bin over the mean bin
+    FEATURE_PEAK
+};
+
+#define SCORE_TOP_K 3 // features reported as the main contributors to a score
 
-extern CArray data; //complex vector for storing vibration data temporarily
-bool store_vibration();
-bool detect_activity();
-void fft(CArray& x);
-vector<float> magnitude(const CArray transform);
-float compare(const vector<float> baseline, const vector<float> current);
-void erase();
-bool isOff();
-vector<float> vectordifference(const vector<float> a, const vector<float> b);
-float vectorsize(const vector<float> a);
+struct AnomalyScore
+{
+    float score;             // RMS of the per-feature z-scores, about 1 for a normal cycle
+    size_t top[SCORE_TOP_K]; // features with the largest |z|, largest first
+    float topZ[SCORE_TOP_K]; // their signed z-scores
+};
+
+using namespace std;
+// the functions below work on caller owned buffers and never allocate
+void extractFeatures(const float* psd, float* features);
+void scoreFeatures(const float* features, const RunningStats<FEATURE_COUNT>& baseline, AnomalyScore& out);
+void describeFeature(size_t i, char* buf, size_t len);
 
 #endif
@@ -0,0 +1,109 @@
+#include <cstring>
+#include "welch.h"
+#include "fftEngine.h"
+
+namespace
+{
+    // periodic Hann window, built at compile time so it sits in flash
+    struct HannWindow
+    {
+        float w[FFT_SIZE];
+
+        constexpr HannWindow() : w()
+        {
+            for (size_t i = 0; i < FFT_SIZE; i++)
+            {
+                double angle = 2.0 * fft_detail::PI * (double)i / (double)FFT_SIZE;
+                if (angle > fft_detail::PI)
+                {
+                    angle -= 2.0 * fft_detail::PI;
+                }
+                w[i] = (float)(0.5 - 0.5 * fft_detail::taylorCos(angle));
+            }
+        }
+    };
+
+    constexpr HannWindow hann{};
+
+    // sum of w[i]^2 for a periodic Hann window
+    const float WINDOW_POWER = 3.0f * FFT_SIZE / 8.0f;
+}
+
+WelchAccumulator::WelchAccumulator()
+{
+    reset();
+}
+
+void WelchAccumulator::reset()
+{
+    memset(psdSum, 0, sizeof(psdSum));
+    filled = 0;
+    count = 0;
+}
+
+void WelchAccumulator::addSamples(const float *x, size_t n)
+{
+    while (n > 0)
+    {
+        size_t take = FFT_SIZE - filled;
+        if (take > n)
+        {
+            take = n;
+        }
+        memcpy(segment + filled, x, take * sizeof(float));
+        filled += take;
+        x += take;
+        n -= take;
+
+        if (filled == FFT_SIZE)
+        {
+            processSegment();
+            // keep the newer half as the start of the next segment
+            memmove(segment, segment + HOP, (FFT_SIZE - HOP) * sizeof(float));
+            filled = FFT_SIZE - HOP;
+        }
+    }
+}
+
+void WelchAccumulator::processSegment()
+{
+    float mean = 0.0f;
+    for (size_t i = 0; i < FFT_SIZE; i++)
+    {
+        mean += segment[i];
+    }
+    mean /= FFT_SIZE;
+
+    for (size_t i = 0; i < FFT_SIZE; i++)
+    {
+        work[i] = (segment[i] - mean) * hann.w[i];
+    }
+    RealFFTEngine<FFT_SIZE>::forward(work);
+
+    for (size_t k = 0; k < SPECTRUM_BINS; k++)
+    {
+        psdSum[k] += work[2 * k] * work[2 * k] + work[2 * k + 1] * work[2 * k + 1];
+    }
+    count++;
+}
+
+size_t WelchAccumulator::segments() const
+{
+    return count;
+}
+
+void WelchAccumulator::average(float *psd) const
+{
+    if (count == 0)
+    {
+        memset(psd, 0, SPECTRUM_BINS * sizeof(float));
+        return;
+    }
+    // one-sided density: every bin but DC and Nyquist also carries its mirror
+    const float scale = 1.0f / (count * VIBRATION_SAMPLE_RATE * WINDOW_POWER);
+    for (size_t k = 0; k < SPECTRUM_BINS; k++)
+    {
+        float s = (k == 0 || k == SPECTRUM_BINS - 1) ? scale : 2.0f * scale;
+        psd[k] = psdSum[k] * s;
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef WELCH_H
+#define WELCH_H
+
+#include <cstddef>
+#include "vibration.h"
+
+/*
+ * Streaming Welch power spectral density estimate.
+ *
+ * Samples are cut into FFT_SIZE long segments overlapping by half. Each
+ * segment has its mean removed, is multiplied by a Hann window and is
+ * transformed, and its power spectrum is added to a running sum. Averaging
+ * over every segment of a compressor cycle gives a much lower variance
+ * spectrum than any single block.
+ *
+ * All buffers are fixed members, so the accumulator never allocates.
+ */
+class WelchAccumulator
+{
+public:
+    static const size_t HOP = FFT_SIZE / 2;
+
+    WelchAccumulator();
+
+    // append samples, every HOP new samples completes a segment
+    void addSamples(const float *x, size_t n);
+
+    // forget all segments and buffered samples, e.g. at the end of a cycle
+    void reset();
+
+    // number of segments averaged so far
+    size_t segments() const;
+
+    // write the averaged one-sided PSD (SPECTRUM_BINS values, counts^2/Hz)
+    void average(float *psd) const;
+
+private:
+    void processSegment();
+
+    float segment[FFT_SIZE];  // most recent samples, oldest first
+    float work[FFT_SIZE + 2]; // windowed segment, then its spectrum
+    float psdSum[SPECTRUM_BINS];
+    size_t filled;
+    size_t count;
+};
+
+#endif
@@ -0,0 +1,11 @@
+#!/bin/sh
+# Builds the FFT accuracy check for the PC. It only needs the header-only
+# engines, so no stand-ins are involved.
+set -e
+here="$(cd "$(dirname "$0")" && pwd)"
+src="$here/../../src"
+${CXX:-g++} -std=gnu++14 -O2 -Wall -Wno-sign-compare \
+    -I"$src" \
+    "$here/fftCheck.cpp" \
+    -o "$here/fftCheck"
+echo "built $here/fftCheck"
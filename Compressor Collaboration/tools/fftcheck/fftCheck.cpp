@@ -0,0 +1,125 @@
+/*
+ * FFT accuracy check: compares the table driven engines in src/fftEngine.h
+ * with a direct DFT in double precision.
+ *
+ *   tools/fftcheck/build.sh
+ *   tools/fftcheck/fftCheck
+ *
+ * Every size the firmware uses, and a few around it, is transformed for
+ * random noise, a pure tone and an impulse. The error is the largest
+ * difference from the reference over all bins, relative to the largest
+ * reference magnitude. The exit status is 1 if any transform is off by
+ * more than TOLERANCE, so the check can run before a firmware build.
+ */
+
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "fftEngine.h"
+#include "vibration.h"
+
+#define TOLERANCE 1e-5 // float32 round-off grows with log2(N), this leaves margin at 4096
+
+typedef std::complex<double> Reference;
+
+static std::vector<Reference> dft(const std::vector<Reference> &x)
+{
+    const size_t n = x.size();
+    std::vector<Reference> out(n);
+    for (size_t k = 0; k < n; k++)
+    {
+        Reference sum = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            double angle = -2.0 * fft_detail::PI * (double)((k * i) % n) / (double)n;
+            sum += x[i] * Reference(cos(angle), sin(angle));
+        }
+        out[k] = sum;
+    }
+    return out;
+}
+
+static double relativeError(const std::vector<Reference> &expect, const float *actual, size_t bins)
+{
+    double largest = 0.0, worst = 0.0;
+    for (size_t k = 0; k < bins; k++)
+    {
+        largest = fmax(largest, std::abs(expect[k]));
+        worst = fmax(worst, std::abs(expect[k] - Reference(actual[2 * k], actual[2 * k + 1])));
+    }
+    return largest > 0.0 ? worst / largest : worst;
+}
+
+// test signals, the same for the complex and real transforms
+static std::vector<Reference> signal(size_t n, int kind, bool real)
+{
+    std::vector<Reference> x(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        double re = 0.0, im = 0.0;
+        if (kind == 0)
+        {
+            re = rand() / (double)RAND_MAX - 0.5;
+            im = real ? 0.0 : rand() / (double)RAND_MAX - 0.5;
+        }
+        else if (kind == 1)
+        {
+            re = cos(2.0 * fft_detail::PI * 37.25 * i / n) * 2048.0;
+        }
+        else
+        {
+            re = i == 3 ? 1.0 : 0.0;
+        }
+        x[i] = Reference(re, im);
+    }
+    return x;
+}
+
+static const char *KINDS[] = {"noise", "tone", "impulse"};
+
+template <size_t N>
+static bool check()
+{
+    bool ok = true;
+    for (int kind = 0; kind < 3; kind++)
+    {
+        std::vector<Reference> x = signal(N, kind, false);
+        std::vector<Reference> expect = dft(x);
+        static std::complex<float> work[N];
+        for (size_t i = 0; i < N; i++)
+        {
+            work[i] = std::complex<float>((float)x[i].real(), (float)x[i].imag());
+        }
+        FFTEngine<N>::forward(work);
+        double error = relativeError(expect, reinterpret_cast<float *>(work), N);
+        printf("complex %5zu %-8s %.2e %s\n", N, KINDS[kind], error, error <= TOLERANCE ? "ok" : "FAIL");
+        ok = ok && error <= TOLERANCE;
+
+        x = signal(N, kind, true);
+        expect = dft(x);
+        static float real[N + 2];
+        for (size_t i = 0; i < N; i++)
+        {
+            real[i] = (float)x[i].real();
+        }
+        RealFFTEngine<N>::forward(real);
+        error = relativeError(expect, real, RealFFTEngine<N>::BINS);
+        printf("real    %5zu %-8s %.2e %s\n", N, KINDS[kind], error, error <= TOLERANCE ? "ok" : "FAIL");
+        ok = ok && error <= TOLERANCE;
+    }
+    return ok;
+}
+
+int main()
+{
+    srand(1);
+    bool ok = check<8>();
+    ok = check<64>() && ok;
+    ok = check<512>() && ok;
+    ok = check<FFT_SIZE>() && ok;
+    ok = check<4096>() && ok;
+    printf(ok ? "all transforms within %.0e\n" : "some transforms off by more than %.0e\n", TOLERANCE);
+    return ok ? 0 : 1;
+}
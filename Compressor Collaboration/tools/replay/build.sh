@@ -0,0 +1,13 @@
+#!/bin/sh
+# Builds the detection benchmark for the PC from the firmware sources that
+# do not need the ESP32, with the stand-ins in host/ for the rest.
+set -e
+here="$(cd "$(dirname "$0")" && pwd)"
+src="$here/../../src"
+${CXX:-g++} -std=gnu++14 -O2 -Wall -Wno-sign-compare \
+    -I"$here/host" -I"$here" -I"$src" \
+    "$here/detectBench.cpp" "$here/hostPlatform.cpp" \
+    "$src/compressorDetect.cpp" "$src/changePoint.cpp" "$src/acquisition.cpp" \
+    "$src/welch.cpp" "$src/vibration.cpp" \
+    -o "$here/detectBench"
+echo "built $here/detectBench"
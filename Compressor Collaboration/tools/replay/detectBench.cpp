@@ -0,0 +1,405 @@
+/*
+ * Detection benchmark: replays a serial capture through the on/off detectors
+ * and the vibration scoring compiled for the PC.
+ *
+ *   tools/replay/build.sh
+ *   tools/replay/detectBench [-v] [--rms-ms N] [--block-ms N] [--tolerance-s N] capture.txt
+ *
+ * The capture is read line by line and turned back into time series:
+ *
+ *   "RMS: x baseline: ..."     a logged vibration window, --rms-ms long (500)
+ *   "Current variance: x"      an older logged window, sqrt(x) over 1 s
+ *   a bare integer             one raw ADC sample, 1 ms
+ *   "Temp Delta: d, a, b"      a temperature reading b in F, 5 s
+ *   "Temperature: x °C"        a temperature reading, takes no time
+ *   "Transform calculated"     a state 2 block with no level logged, --block-ms (10240)
+ *   "[ 91188][E][...]"          an ESP-IDF log line, millis() since the last reset
+ *
+ * The firmware the captures come from sampled state 2 every 5 ms, so a block
+ * of 2048 samples took about 10 s. The ESP-IDF log lines carry the real time
+ * since boot, and the replayed clock is moved forward to them whenever it
+ * has fallen behind. The first one after the start of the capture or a reset
+ * ("rst:", or a time lower than the last) only fixes when the boot was.
+ *
+ * A boot ("Program Setup") starts the detectors and the firmware state over,
+ * as the device does; checkpoints they saved are kept. The firmware's own
+ * decisions ("Changed to State 2", "Switching to state 1") are the reference
+ * transitions. Every detector is scored against them:
+ * latency (negative is earlier than the firmware was), missed references and
+ * transitions with no reference within --tolerance-s (600) per replayed hour.
+ * The CPU time of every stage is measured on this machine, which gives
+ * relative costs rather than ESP32 timings.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "Arduino.h"
+#include "acquisition.h"
+#include "compressorDetect.h"
+#include "welch.h"
+#include "hostPlatform.h"
+
+#define SCORE_BLOCKS 8      // blocks averaged into one replayed cycle
+#define SCORE_TRAIN_CYCLES 10 // cycles used as the baseline before scoring
+
+struct Event
+{
+    unsigned long ms;
+    bool on;
+};
+
+struct Stage
+{
+    const char *name;
+    double seconds;
+    unsigned long calls;
+};
+
+struct Detector
+{
+    const char *name;
+    std::vector<Event> events;
+};
+
+static std::chrono::steady_clock::time_point stageStart;
+
+static void startStage()
+{
+    stageStart = std::chrono::steady_clock::now();
+}
+
+static void endStage(Stage &stage)
+{
+    stage.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - stageStart).count();
+    stage.calls++;
+}
+
+// true and the number after the prefix if the line contains it
+static bool numberAfter(const char *line, const char *prefix, float &value)
+{
+    const char *p = strstr(line, prefix);
+    if (!p)
+    {
+        return false;
+    }
+    p += strlen(prefix);
+    char *end;
+    value = strtof(p, &end);
+    return end != p;
+}
+
+static bool bareInteger(const char *line, long &value)
+{
+    char *end;
+    value = strtol(line, &end, 10);
+    if (end == line)
+    {
+        return false;
+    }
+    while (*end == ' ' || *end == '\r' || *end == '\n')
+    {
+        end++;
+    }
+    return *end == '\0';
+}
+
+static void report(const Detector &d, const std::vector<Event> &reference, double hours, double toleranceS)
+{
+    std::vector<bool> used(d.events.size(), false);
+    std::vector<double> latencies;
+    int missed = 0;
+    for (const Event &ref : reference)
+    {
+        int best = -1;
+        double bestDiff = 0;
+        for (size_t i = 0; i < d.events.size(); i++)
+        {
+            double diff = ((double)d.events[i].ms - (double)ref.ms) / 1000.0;
+            if (used[i] || d.events[i].on != ref.on || fabs(diff) > toleranceS)
+            {
+                continue;
+            }
+            if (best < 0 || fabs(diff) < fabs(bestDiff))
+            {
+                best = (int)i;
+                bestDiff = diff;
+            }
+        }
+        if (best < 0)
+        {
+            missed++;
+            continue;
+        }
+        used[best] = true;
+        latencies.push_back(bestDiff);
+    }
+    int unmatched = 0;
+    for (bool u : used)
+    {
+        unmatched += u ? 0 : 1;
+    }
+
+    printf("%-22s %5zu transitions, %3zu matched, %3d missed", d.name, d.events.size(), latencies.size(), missed);
+    if (!latencies.empty())
+    {
+        double sum = 0;
+        for (double l : latencies)
+        {
+            sum += l;
+        }
+        std::vector<double> sorted = latencies;
+        std::sort(sorted.begin(), sorted.end());
+        printf(", latency mean %7.1f s median %7.1f s", sum / latencies.size(), sorted[sorted.size() / 2]);
+    }
+    printf(", %5.2f false/h\n", hours > 0 ? unmatched / hours : 0.0);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long rmsMs = 500;
+    unsigned long blockMs = 10240;
+    double toleranceS = 600;
+    const char *path = nullptr;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-v"))
+        {
+            hostVerbose = true;
+        }
+        else if (!strcmp(argv[i], "--rms-ms") && i + 1 < argc)
+        {
+            rmsMs = strtoul(argv[++i], nullptr, 10);
+        }
+        else if (!strcmp(argv[i], "--block-ms") && i + 1 < argc)
+        {
+            blockMs = strtoul(argv[++i], nullptr, 10);
+        }
+        else if (!strcmp(argv[i], "--tolerance-s") && i + 1 < argc)
+        {
+            toleranceS = strtod(argv[++i], nullptr);
+        }
+        else
+        {
+            path = argv[i];
+        }
+    }
+    if (!path)
+    {
+        fprintf(stderr, "usage: %s [-v] [--rms-ms N] [--block-ms N] [--tolerance-s N] capture.txt\n", argv[0]);
+        return 2;
+    }
+    FILE *f = fopen(path, "rb");
+    if (!f)
+    {
+        perror(path);
+        return 1;
+    }
+
+    Stage parse = {"parse", 0, 0};
+    Stage fusedStage = {"fused detector", 0, 0};
+    Stage vibStage = {"legacy vibration", 0, 0};
+    Stage tempStage = {"legacy temperature", 0, 0};
+    Stage welchStage = {"welch spectrum", 0, 0};
+    Stage scoreStage = {"features + score", 0, 0};
+
+    Detector fused = {"fused change-point", {}};
+    Detector legacyVib = {"legacy vibration", {}};
+    Detector legacyTemp = {"legacy temperature", {}};
+    std::vector<Event> reference;
+
+    CompressorDetector detector;
+    TempTransitionDetector tempDetector;
+    bool vibState = false;
+
+    static WelchAccumulator welch;
+    std::vector<float> raw;
+    RunningStats<FEATURE_COUNT> stats;
+    stats.reset();
+    static float psd[SPECTRUM_BINS];
+    float features[FEATURE_COUNT];
+    AnomalyScore score;
+    int cycles = 0;
+    double scoreSum = 0;
+    int scored = 0;
+
+    unsigned long lines = 0;
+    unsigned long bootMs = 0;    // replayed time of the last reset
+    unsigned long lastSince = 0; // newest ESP-IDF log time since that reset
+    bool booted = false;         // bootMs is known
+    char line[512];
+    while (true)
+    {
+        startStage();
+        if (!fgets(line, sizeof(line), f))
+        {
+            break;
+        }
+        lines++;
+        bool stepped = true;
+        float value;
+        long sample;
+        if (numberAfter(line, "RMS: ", value))
+        {
+            hostMillis += rmsMs;
+            acquisitionPushLevel(value, 0.0f, rmsMs * (size_t)VIBRATION_SAMPLE_RATE / 1000);
+        }
+        else if (numberAfter(line, "Current variance: ", value))
+        {
+            hostMillis += 1000;
+            acquisitionPushLevel(sqrtf(value > 0 ? value : 0), 0.0f, (size_t)VIBRATION_SAMPLE_RATE);
+        }
+        else if (bareInteger(line, sample))
+        {
+            hostMillis += 1;
+            acquisitionPushSample((float)sample);
+            raw.push_back((float)sample);
+        }
+        else if (numberAfter(line, "Temp Delta: ", value))
+        {
+            // "Temp Delta: d, older, newest"
+            const char *last = strrchr(line, ',');
+            hostMillis += 5000;
+            if (last)
+            {
+                replaySetTemp(strtof(last + 1, nullptr));
+            }
+        }
+        else if (numberAfter(line, "Temperature: ", value))
+        {
+            replaySetTemp(strstr(line, "F") ? value : value * 1.8f + 32.0f);
+            stepped = false;
+        }
+        else if (strstr(line, "Transform calculated"))
+        {
+            hostMillis += blockMs;
+        }
+        else
+        {
+            stepped = false;
+            unsigned long since;
+            if (strstr(line, "rst:"))
+            {
+                bootMs = hostMillis;
+                lastSince = 0;
+                booted = true;
+            }
+            else if (sscanf(line, "[%lu][", &since) == 1)
+            {
+                if (!booted || since < lastSince)
+                {
+                    bootMs = hostMillis > since ? hostMillis - since : 0;
+                    booted = true;
+                }
+                else if (bootMs + since > hostMillis)
+                {
+                    hostMillis = bootMs + since;
+                }
+                lastSince = since;
+            }
+            else if (strstr(line, "Program Setup"))
+            {
+                detector = CompressorDetector();
+                tempDetector = TempTransitionDetector();
+                vibState = false;
+            }
+            else if (strstr(line, "Changed to State 2"))
+            {
+                reference.push_back({hostMillis, true});
+            }
+            else if (strstr(line, "Switching to state 1"))
+            {
+                reference.push_back({hostMillis, false});
+            }
+        }
+        endStage(parse);
+        if (!stepped)
+        {
+            continue;
+        }
+
+        startStage();
+        Transition t = detector.update();
+        endStage(fusedStage);
+        if (t != TRANSITION_NONE)
+        {
+            fused.events.push_back({hostMillis, t == TRANSITION_ON});
+        }
+
+        startStage();
+        bool vibNow = compressorRunning(vibState);
+        endStage(vibStage);
+        if (vibNow != vibState)
+        {
+            vibState = vibNow;
+            legacyVib.events.push_back({hostMillis, vibNow});
+        }
+
+        startStage();
+        t = tempDetector.update();
+        endStage(tempStage);
+        if (t != TRANSITION_NONE)
+        {
+            legacyTemp.events.push_back({hostMillis, t == TRANSITION_ON});
+        }
+
+        if (raw.size() == FFT_SIZE)
+        {
+            startStage();
+            welch.addSamples(raw.data(), raw.size());
+            endStage(welchStage);
+            raw.clear();
+            if (welch.segments() >= SCORE_BLOCKS)
+            {
+                startStage();
+                welch.average(psd);
+                extractFeatures(psd, features);
+                if (cycles < SCORE_TRAIN_CYCLES)
+                {
+                    stats.add(features);
+                }
+                else
+                {
+                    scoreFeatures(features, stats, score);
+                    scoreSum += score.score;
+                    scored++;
+                }
+                endStage(scoreStage);
+                welch.reset();
+                cycles++;
+            }
+        }
+    }
+    fclose(f);
+
+    double hours = hostMillis / 3600000.0;
+    if (reference.empty() || hostMillis == 0)
+    {
+        fprintf(stderr, "%s: %lu lines, %.2f h replayed, %zu reference transitions, nothing to score against\n", path,
+                lines, hours, reference.size());
+        return 1;
+    }
+    printf("%s: %lu lines, %.2f h replayed, %zu reference transitions\n", path, lines, hours, reference.size());
+    report(fused, reference, hours, toleranceS);
+    report(legacyVib, reference, hours, toleranceS);
+    report(legacyTemp, reference, hours, toleranceS);
+    if (scored > 0)
+    {
+        printf("vibration score: %d cycles scored against %d, mean %.2f\n", scored, SCORE_TRAIN_CYCLES, scoreSum / scored);
+    }
+    else
+    {
+        printf("vibration score: %d cycles of raw samples, too few to score\n", cycles);
+    }
+
+    printf("\n%-20s %10s %12s\n", "stage", "calls", "us/call");
+    const Stage *stages[] = {&parse, &fusedStage, &vibStage, &tempStage, &welchStage, &scoreStage};
+    for (const Stage *s : stages)
+    {
+        printf("%-20s %10lu %12.3f\n", s->name, s->calls, s->calls ? 1e6 * s->seconds / s->calls : 0.0);
+    }
+    return 0;
+}
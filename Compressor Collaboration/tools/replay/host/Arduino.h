@@ -0,0 +1,78 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+// Just enough of the Arduino core to compile the detectors on a PC. Time is
+// the replay clock, set by the harness as it steps through a capture.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+
+typedef uint8_t byte;
+
+extern unsigned long hostMillis;
+extern bool hostVerbose;
+
+inline unsigned long millis() { return hostMillis; }
+inline unsigned long micros() { return hostMillis * 1000UL; }
+inline void delay(unsigned long ms) { hostMillis += ms; }
+inline void delayMicroseconds(unsigned int) {}
+
+class String
+{
+public:
+    String() {}
+    String(const char *s) : str(s) {}
+    String(const std::string &s) : str(s) {}
+    String(char c) : str(1, c) {}
+    String(int v) : str(std::to_string(v)) {}
+    String(unsigned int v) : str(std::to_string(v)) {}
+    String(long v) : str(std::to_string(v)) {}
+    String(unsigned long v) : str(std::to_string(v)) {}
+    String(float v, int decimals = 2) { format(v, decimals); }
+    String(double v, int decimals = 2) { format(v, decimals); }
+
+    size_t length() const { return str.size(); }
+    const char *c_str() const { return str.c_str(); }
+    float toFloat() const { return strtof(str.c_str(), nullptr); }
+
+    String &operator+=(const String &s)
+    {
+        str += s.str;
+        return *this;
+    }
+    friend String operator+(String a, const String &b) { return a += b; }
+    friend String operator+(String a, const char *b) { return a += String(b); }
+    friend String operator+(const char *a, const String &b) { return String(a) += b; }
+
+private:
+    void format(double v, int decimals)
+    {
+        char buf[48];
+        snprintf(buf, sizeof(buf), "%.*f", decimals, v);
+        str = buf;
+    }
+
+    std::string str;
+};
+
+struct HostSerial
+{
+    void print(const String &s)
+    {
+        if (hostVerbose)
+            fputs(s.c_str(), stderr);
+    }
+    void println(const String &s)
+    {
+        if (hostVerbose)
+            fprintf(stderr, "%s\n", s.c_str());
+    }
+};
+
+extern HostSerial Serial;
+
+#endif
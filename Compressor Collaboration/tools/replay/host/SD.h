@@ -0,0 +1,35 @@
+#ifndef HOST_SD_H
+#define HOST_SD_H
+
+// A card that is never there, so the detectors calibrate from the replay
+// instead of state left by an earlier run.
+
+#include "Arduino.h"
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+class File
+{
+public:
+    explicit operator bool() const { return false; }
+    size_t size() const { return 0; }
+    size_t read(uint8_t *, size_t) { return 0; }
+    size_t write(const uint8_t *, size_t) { return 0; }
+    void println(const String &) {}
+    void close() {}
+};
+
+class HostSD
+{
+public:
+    bool exists(const String &) { return false; }
+    File open(const String &, const char * = FILE_READ) { return File(); }
+    bool remove(const String &) { return false; }
+    bool rename(const String &, const String &) { return false; }
+};
+
+extern HostSD SD;
+
+#endif
@@ -0,0 +1,72 @@
+// Host stand-ins for the firmware pieces the detectors call: the clock, the
+// log and the temperature driver. Temperatures come from the capture.
+
+#include <map>
+#include <string>
+#include <vector>
+#include "Arduino.h"
+#include "SD.h"
+#include "dataStorage.h"
+#include "getTemp.h"
+#include "storage.h"
+#include "hostPlatform.h"
+
+unsigned long hostMillis = 0;
+bool hostVerbose = false;
+HostSerial Serial;
+HostSD SD;
+
+static float replayTemp = -1000;
+
+void replaySetTemp(float f)
+{
+    replayTemp = f;
+}
+
+void logPrintln(const String &msg)
+{
+    Serial.println(msg);
+}
+
+void logPrint(const String &msg)
+{
+    Serial.print(msg);
+}
+
+// checkpoints survive the replayed reboots of one run, nothing is kept
+// between runs
+static std::map<std::string, std::vector<uint8_t>> checkpoints;
+
+bool saveBinary(const char *path, const void *data, size_t len)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+    checkpoints[path].assign(bytes, bytes + len);
+    return true;
+}
+
+bool loadBinary(const char *path, void *data, size_t len)
+{
+    auto it = checkpoints.find(path);
+    if (it == checkpoints.end() || it->second.size() != len)
+    {
+        return false;
+    }
+    memcpy(data, it->second.data(), len);
+    return true;
+}
+
+bool storeBinary(const char *path, const void *data, size_t len)
+{
+    return saveBinary(path, data, len);
+}
+
+TempStatus getTemp(float &temp)
+{
+    temp = replayTemp;
+    return replayTemp > -1000 ? TEMP_OK : TEMP_NO_SENSOR;
+}
+
+float getTemp()
+{
+    return replayTemp;
+}
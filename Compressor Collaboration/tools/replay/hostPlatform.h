@@ -0,0 +1,7 @@
+#ifndef HOSTPLATFORM_H
+#define HOSTPLATFORM_H
+
+// latest temperature in degrees F seen in the capture, returned by getTemp()
+void replaySetTemp(float f);
+
+#endif